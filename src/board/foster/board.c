@@ -166,7 +166,8 @@ static int board_setup(void)
 
 	/* Audio init */
 	TegraAudioHubXbar *xbar = new_tegra_audio_hub_xbar(0x70300800);
-	TegraAudioHubApbif *apbif = new_tegra_audio_hub_apbif(0x70300000, 8);
+	TegraAudioHubApbif *apbif =
+		new_tegra_audio_hub_apbif(0x70300000, 8, NULL);
 	TegraI2s *i2s1 = new_tegra_i2s(0x70301100, &apbif->ops, 1, 16, 2,
 				       1536000, 48000);
 	TegraAudioHub *ahub = new_tegra_audio_hub(xbar, apbif, i2s1);
@@ -26,7 +26,7 @@
 #include "base/init_funcs.h"
 #include "drivers/ec/cros/lpc.h"
 #include "drivers/gpio/sysinfo.h"
-#include "drivers/flash/memmapped.h"
+#include "drivers/flash/fast_spi.h"
 #include "drivers/tpm/tpm.h"
 #include "drivers/bus/usb/usb.h"
 #include "drivers/power/pch.h"
@@ -39,39 +39,10 @@
 #define EMMC_CLOCK_MAX          25000000
 #define SD_CLOCK_MAX            52000000
 
-#define SPIBAR_BIOS_BFPREG	(0x0)
-#define  BFPREG_BASE_MASK       (0x7fff)
-#define  BFPREG_LIMIT_SHIFT     (16)
-#define  BFPREG_LIMIT_MASK      (0x7fff << BFPREG_LIMIT_SHIFT)
-
 static void board_flash_init(void)
 {
-	uintptr_t mmio_base = pci_read_config32(PCI_DEV(0, 0xd, 2),
-						PCI_BASE_ADDRESS_0);
-	mmio_base &= PCI_BASE_ADDRESS_MEM_MASK;
-
-	uint32_t val = read32((void *)(mmio_base + SPIBAR_BIOS_BFPREG));
-
-	uintptr_t mmap_start;
-	size_t bios_base, bios_end, mmap_size;
-
-	bios_base = (val & BFPREG_BASE_MASK) * 4 * KiB;
-	bios_end  = (((val & BFPREG_LIMIT_MASK) >> BFPREG_LIMIT_SHIFT) + 1) *
-		4 * KiB;
-	mmap_size = bios_end - bios_base;
-
-	/* BIOS region is mapped directly below 4GiB. */
-	mmap_start = 4ULL * GiB - mmap_size;
-
-	printf("BIOS MMAP details:\n");
-	printf("IFD Base Offset  : 0x%zx\n", bios_base);
-	printf("IFD End Offset   : 0x%zx\n", bios_end);
-	printf("MMAP Size        : 0x%zx\n", mmap_size);
-	printf("MMAP Start       : 0x%lx\n", mmap_start);
-
 	/* W25Q128FV SPI Flash */
-	flash_set_ops(&new_mem_mapped_flash_with_offset(mmap_start, mmap_size,
-							bios_base)->ops);
+	flash_set_ops(&new_fast_spi_flash(PCI_DEV(0, 0xd, 2))->ops);
 }
 
 static int board_setup(void)
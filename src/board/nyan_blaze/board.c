@@ -125,7 +125,8 @@ static int board_setup(void)
 				       APBDMA_SLAVE_SL2B1);
 
 	TegraAudioHubXbar *xbar = new_tegra_audio_hub_xbar(0x70300800);
-	TegraAudioHubApbif *apbif = new_tegra_audio_hub_apbif(0x70300000, 8);
+	TegraAudioHubApbif *apbif =
+		new_tegra_audio_hub_apbif(0x70300000, 8, dma_controller);
 
 	TegraI2s *i2s1 = new_tegra_i2s(0x70301100, &apbif->ops, 1, 16, 2,
 				       4800000, 48000);
@@ -29,7 +29,7 @@
 #include "drivers/ec/cros/lpc.h"
 #include "drivers/ec/anx3429/anx3429.h"
 #include "drivers/ec/ps8751/ps8751.h"
-#include "drivers/flash/memmapped.h"
+#include "drivers/flash/fast_spi.h"
 #include "drivers/gpio/sysinfo.h"
 #include "drivers/soc/apollolake.h"
 #include "drivers/tpm/cr50_i2c.h"
@@ -47,12 +47,6 @@
 #define EMMC_CLOCK_MAX		200000000
 #define SD_CLOCK_MAX		52000000
 
-#define SPIBAR_BIOS_BFPREG     (0x0)
-#define  SPIBAR_BIOS_BFPREG	(0x0)
-#define  BFPREG_BASE_MASK       (0x7fff)
-#define  BFPREG_LIMIT_SHIFT     (16)
-#define  BFPREG_LIMIT_MASK      (0x7fff << BFPREG_LIMIT_SHIFT)
-
 #define AUD_VOLUME		4000
 #define SDMODE_PIN		GPIO_76
 
@@ -62,32 +56,8 @@
 
 static void board_flash_init(void)
 {
-	uintptr_t mmio_base = pci_read_config32(PCI_DEV(0, 0xd, 2),
-						PCI_BASE_ADDRESS_0);
-	mmio_base &= PCI_BASE_ADDRESS_MEM_MASK;
-
-	uint32_t val = read32((void *)(mmio_base + SPIBAR_BIOS_BFPREG));
-
-	uintptr_t mmap_start;
-	size_t bios_base, bios_end, mmap_size;
-
-	bios_base = (val & BFPREG_BASE_MASK) * 4 * KiB;
-	bios_end  = (((val & BFPREG_LIMIT_MASK) >> BFPREG_LIMIT_SHIFT) + 1) *
-		4 * KiB;
-	mmap_size = bios_end - bios_base;
-
-	/* BIOS region is mapped directly below 4GiB. */
-	mmap_start = 4ULL * GiB - mmap_size;
-
-	printf("BIOS MMAP details:\n");
-	printf("IFD Base Offset  : 0x%zx\n", bios_base);
-	printf("IFD End Offset   : 0x%zx\n", bios_end);
-	printf("MMAP Size        : 0x%zx\n", mmap_size);
-	printf("MMAP Start       : 0x%lx\n", mmap_start);
-
 	/* W25Q128FV SPI Flash */
-	flash_set_ops(&new_mem_mapped_flash_with_offset(mmap_start, mmap_size,
-							bios_base)->ops);
+	flash_set_ops(&new_fast_spi_flash(PCI_DEV(0, 0xd, 2))->ops);
 }
 
 static int cr50_irq_status(void)
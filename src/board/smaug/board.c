@@ -208,7 +208,8 @@ static int board_setup(void)
 
 	/* Audio init */
 	TegraAudioHubXbar *xbar = new_tegra_audio_hub_xbar(AXBAR_BASE);
-	TegraAudioHubApbif *apbif = new_tegra_audio_hub_apbif(ADMAIF_BASE, 8);
+	TegraAudioHubApbif *apbif =
+		new_tegra_audio_hub_apbif(ADMAIF_BASE, 8, NULL);
 	TegraI2s *i2s1 = new_tegra_i2s(I2S1_BASE, &apbif->ops, 1, 16, 2,
 				       1536000, 48000);
 	TegraAudioHub *ahub = new_tegra_audio_hub(xbar, apbif, i2s1);
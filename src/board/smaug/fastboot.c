@@ -250,6 +250,12 @@ backend_ret_t board_write_partition(const char *name, void *image_addr,
 	return BE_SUCCESS;
 }
 
+/* Bootloader images have to be split up by board_write_partition. */
+int board_can_stream_partition(const char *name)
+{
+	return strcmp(name, "bootloader") != 0;
+}
+
 static const struct {
 	fb_button_type button;
 	const char *string;
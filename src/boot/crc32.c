@@ -27,9 +27,16 @@
 
 
 static int crc_table_empty = 1;
-static uint32_t crc_table[256];
+/* crc_table[k][n] is the CRC of byte n followed by k zero bytes */
+static uint32_t crc_table[8][256];
+/* x2n_table[k] is x^(2^k) modulo the polynomial */
+static uint32_t x2n_table[32];
 static void make_crc_table (void);
 
+#if CONFIG_ARCH_ARM_V8
+static int crc_hw;
+#endif
+
 /*
   Generate a table for a byte-wise 32-bit CRC calculation on the polynomial:
   x^32+x^26+x^23+x^22+x^16+x^12+x^11+x^10+x^8+x^7+x^5+x^4+x^2+x+1.
@@ -53,15 +60,67 @@ static void make_crc_table (void);
   The table is simply the CRC of all possible eight bit values.  This is all
   the information needed to generate CRC's on data a byte at a time for all
   combinations of CRC register values and incoming bytes.
+
+  The seven further tables extend this to a byte followed by one to seven
+  zero bytes, so that eight bytes can be folded in with eight independent
+  lookups ("slice-by-8") instead of eight dependent ones.
 */
 /* terms of polynomial defining this crc (except x^32): */
 static const uint8_t p[] = {0,1,2,4,5,7,8,10,11,12,16,22,23,26};
 
+/* Polynomial exclusive-or pattern, 0xedb88320 */
+static uint32_t poly;
+
+/*
+ * Multiply a and b modulo the polynomial. Both are in the same reflected
+ * representation as the CRC itself, so x^0 is 0x80000000.
+ */
+static uint32_t multmodp(uint32_t a, uint32_t b)
+{
+	uint32_t m = 1U << 31;
+	uint32_t prod = 0;
+
+	for (;;) {
+		if (a & m) {
+			prod ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = b & 1 ? poly ^ (b >> 1) : b >> 1;
+	}
+	return prod;
+}
+
+/* Return x^(n * 2^k) modulo the polynomial. */
+static uint32_t x2nmodp(uint64_t n, unsigned k)
+{
+	uint32_t prod = 1U << 31;
+
+	while (n) {
+		if (n & 1)
+			prod = multmodp(x2n_table[k & 31], prod);
+		n >>= 1;
+		k++;
+	}
+	return prod;
+}
+
+#if CONFIG_ARCH_ARM_V8
+/* Does the CPU implement the optional CRC32 instructions? */
+static int crc32_hw_supported(void)
+{
+	uint64_t isar0;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+	return ((isar0 >> 16) & 0xf) != 0;
+}
+#endif
+
 static void make_crc_table(void)
 {
 	uint32_t c;
 	int n, k;
-	uint32_t poly;		/* polynomial exclusive-or pattern */
 
 	/* make exclusive-or pattern from polynomial (0xedb88320L) */
 	poly = 0L;
@@ -72,13 +131,31 @@ static void make_crc_table(void)
 		c = (uint32_t)n;
 		for (k = 0; k < 8; k++)
 			c = c & 1 ? poly ^ (c >> 1) : c >> 1;
-		crc_table[n] = htole32(c);
+		crc_table[0][n] = c;
+	}
+
+	for (n = 0; n < 256; n++) {
+		c = crc_table[0][n];
+		for (k = 1; k < 8; k++) {
+			c = crc_table[0][c & 0xff] ^ (c >> 8);
+			crc_table[k][n] = c;
+		}
 	}
+
+	/* x^1 */
+	c = 1U << 30;
+	x2n_table[0] = c;
+	for (n = 1; n < 32; n++)
+		x2n_table[n] = c = multmodp(c, c);
+
+#if CONFIG_ARCH_ARM_V8
+	crc_hw = crc32_hw_supported();
+#endif
 	crc_table_empty = 0;
 }
 
 /* ========================================================================= */
-#  define DO_CRC(x) crc = tab[(crc ^ (x)) & 255] ^ (crc >> 8)
+#  define DO_CRC(x) crc = crc_table[0][(crc ^ (x)) & 255] ^ (crc >> 8)
 
 /* ========================================================================= */
 
@@ -88,45 +165,104 @@ static void make_crc_table(void)
 static uint32_t crc32_no_comp(uint32_t crc, const void *p, unsigned len)
 {
 	const uint8_t *buf = p;
-	const uint32_t *tab = crc_table;
-	const uint32_t *b =(const uint32_t *)buf;
-	size_t rem_len;
-	if (crc_table_empty)
-		make_crc_table();
-	crc = htole32(crc);
+	uint32_t one, two;
+
 	/* Align it */
-	if (((long)b) & 3 && len) {
-		uint8_t *p = (uint8_t *)b;
-		do {
-			DO_CRC(*p++);
-		} while ((--len) && ((long)p)&3);
-		b = (uint32_t *)p;
+	while (len && ((uintptr_t)buf & 3)) {
+		DO_CRC(*buf++);
+		len--;
 	}
 
-	rem_len = len & 3;
-	len = len >> 2;
-	for (--b; len; --len) {
-		/* load data 32 bits wide, xor data 32 bits wide. */
-		crc ^= *++b; /* use pre increment for speed */
-		DO_CRC(0);
-		DO_CRC(0);
-		DO_CRC(0);
-		DO_CRC(0);
+	/* Eight bytes at a time, loaded as two little endian words */
+	while (len >= 8) {
+		one = le32toh(*(const uint32_t *)buf) ^ crc;
+		two = le32toh(*(const uint32_t *)(buf + 4));
+		crc = crc_table[7][one & 0xff] ^
+		      crc_table[6][(one >> 8) & 0xff] ^
+		      crc_table[5][(one >> 16) & 0xff] ^
+		      crc_table[4][one >> 24] ^
+		      crc_table[3][two & 0xff] ^
+		      crc_table[2][(two >> 8) & 0xff] ^
+		      crc_table[1][(two >> 16) & 0xff] ^
+		      crc_table[0][two >> 24];
+		buf += 8;
+		len -= 8;
 	}
-	len = rem_len;
+
 	/* And the last few bytes */
-	if (len) {
-		uint8_t *p = (uint8_t *)(b + 1) - 1;
-		do {
-			DO_CRC(*++p); /* use pre increment for speed */
-		} while (--len);
-	}
+	while (len--)
+		DO_CRC(*buf++);
 
-	return le32toh(crc);
+	return crc;
 }
 #undef DO_CRC
 
+#if CONFIG_ARCH_ARM_V8
+/* Same as crc32_no_comp(), using the ARMv8 CRC32 instructions. */
+static uint32_t crc32_no_comp_hw(uint32_t crc, const void *p, unsigned len)
+{
+	const uint8_t *buf = p;
+
+	while (len && ((uintptr_t)buf & 7)) {
+		asm(".arch_extension crc\n\tcrc32b %w0, %w0, %w1"
+		    : "+r" (crc) : "r" (*buf));
+		buf++;
+		len--;
+	}
+
+	while (len >= 8) {
+		asm(".arch_extension crc\n\tcrc32x %w0, %w0, %x1"
+		    : "+r" (crc) : "r" (*(const uint64_t *)buf));
+		buf += 8;
+		len -= 8;
+	}
+
+	while (len--) {
+		asm(".arch_extension crc\n\tcrc32b %w0, %w0, %w1"
+		    : "+r" (crc) : "r" (*buf));
+		buf++;
+	}
+
+	return crc;
+}
+#endif
+
 uint32_t crc32 (uint32_t crc, const void *p, unsigned len)
 {
+	if (crc_table_empty)
+		make_crc_table();
+
+#if CONFIG_ARCH_ARM_V8
+	if (crc_hw)
+		return crc32_no_comp_hw(crc ^ 0xffffffffL, p, len) ^
+			0xffffffffL;
+#endif
+
 	return crc32_no_comp(crc ^ 0xffffffffL, p, len) ^ 0xffffffffL;
 }
+
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2)
+{
+	if (crc_table_empty)
+		make_crc_table();
+
+	return multmodp(x2nmodp(len2, 3), crc1) ^ crc2;
+}
+
+uint32_t crc32_repeat(uint32_t crc, const void *p, unsigned len,
+		      uint64_t count)
+{
+	/* CRC of p repeated 2^n times for increasing n */
+	uint32_t block = crc32(0, p, len);
+	uint64_t block_len = len;
+
+	while (count) {
+		if (count & 1)
+			crc = crc32_combine(crc, block, block_len);
+		block = crc32_combine(block, block, block_len);
+		block_len *= 2;
+		count >>= 1;
+	}
+
+	return crc;
+}
@@ -19,4 +19,14 @@
 
 uint32_t crc32 (uint32_t crc, const void *p, unsigned len);
 
+/*
+ * Return the CRC of the concatenation of two buffers, given the CRC of each
+ * and the length of the second one.
+ */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+
+/* Update crc with count back-to-back copies of the len bytes at p. */
+uint32_t crc32_repeat(uint32_t crc, const void *p, unsigned len,
+		      uint64_t count);
+
 #endif /* __BOOT_CRC32_H__ */
@@ -69,6 +69,23 @@ static int do_spi_write(int argc, char * const argv[], int read_flag)
 	return length != flash_write(offset, length, mem_addr);
 }
 
+static int do_spi_stats(int argc, char * const argv[], int ignore)
+{
+	FlashCache *cache = flash_get_cache();
+
+	if (argc != 0)
+		return CMD_RET_USAGE;
+
+	if (!cache) {
+		printf("flash read cache not enabled\n");
+		return CMD_RET_FAILURE;
+	}
+
+	printf("flash read cache: %u hits, %u misses, %u bytes read\n",
+	       cache->hits, cache->misses, cache->bytes_read);
+	return 0;
+}
+
 static int do_spi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	struct {
@@ -79,7 +96,8 @@ static int do_spi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		{"read", 1, do_spi_read},
 		{"dump", 0, do_spi_read},
 		{"erase", 1, do_spi_erase},
-		{"write", 0, do_spi_write}
+		{"write", 0, do_spi_write},
+		{"stats", 0, do_spi_stats}
 	};
 	int i;
 
@@ -104,4 +122,5 @@ U_BOOT_CMD(
 	"                           into RAM starting at 'addr'\n"
 	"spi write offset len addr - write 'len' bytes starting at 'offset'\n"
 	"                           from RAM starting at 'addr'\n"
+	"spi stats - show flash read cache statistics\n"
 );
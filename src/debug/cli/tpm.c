@@ -37,3 +37,16 @@ U_BOOT_CMD(
 	   "Send a raw TPM command and read response data",
 	   "\n"
 );
+
+static int do_tpm_timing(cmd_tbl_t *cmdtp, int flag, int argc,
+			 char * const argv[])
+{
+	tpm_report_timing();
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	   tpm_timing,	1,	1,
+	   "Show how long the TPM commands sent so far took",
+	   "\n"
+);
@@ -182,6 +182,88 @@ static int i2c_transfer(I2cOps *me, I2cSeg *segments, int seg_count)
 	return 0;
 }
 
+/**
+ * ec_i2c_max_request - Largest passthru request the EC will accept
+ *
+ * @bus: The tunnel bus.
+ */
+static int ec_i2c_max_request(CrosECTunnelI2c *bus)
+{
+	int size = bus->ec->max_param_size;
+
+	/* Not probed yet, every protocol version takes this much */
+	if (size <= 0)
+		size = EC_PROTO2_MAX_PARAM_SIZE;
+	return MIN(size, ARRAY_SIZE(bus->request_buf));
+}
+
+_Static_assert(sizeof(I2cWriteVec) == 2, "I2cWriteVec must be [reg, val]");
+
+int cros_ec_tunnel_i2c_write_regs(CrosECTunnelI2c *bus, uint8_t chip,
+				  const I2cWriteVec *cmds, size_t count)
+{
+	I2cSeg segs[CROS_EC_TUNNEL_MAX_SEGS];
+	size_t per_cmd, batch, i;
+
+	/* Each register write is one message carrying two bytes. */
+	per_cmd = (ec_i2c_max_request(bus) -
+		   sizeof(struct ec_params_i2c_passthru)) /
+		  (sizeof(struct ec_params_i2c_passthru_msg) +
+		   sizeof(*cmds));
+	per_cmd = MIN(per_cmd, ARRAY_SIZE(segs));
+
+	while (count) {
+		batch = MIN(count, per_cmd);
+		for (i = 0; i < batch; i++) {
+			segs[i].read = 0;
+			segs[i].chip = chip;
+			segs[i].buf = (uint8_t *)&cmds[i];
+			segs[i].len = sizeof(*cmds);
+		}
+		if (i2c_transfer(&bus->ops, segs, batch))
+			return -1;
+		cmds += batch;
+		count -= batch;
+	}
+	return 0;
+}
+
+int cros_ec_tunnel_i2c_read_regs(CrosECTunnelI2c *bus, uint8_t chip,
+				 const uint8_t *regs, size_t count,
+				 uint8_t *data)
+{
+	I2cSeg segs[CROS_EC_TUNNEL_MAX_SEGS];
+	size_t per_cmd, batch, i;
+
+	/* Each register read is a one byte write and a one byte read. */
+	per_cmd = (ec_i2c_max_request(bus) -
+		   sizeof(struct ec_params_i2c_passthru)) /
+		  (2 * sizeof(struct ec_params_i2c_passthru_msg) + 1);
+	per_cmd = MIN(per_cmd, ARRAY_SIZE(bus->response_buf) -
+		      sizeof(struct ec_response_i2c_passthru));
+	per_cmd = MIN(per_cmd, ARRAY_SIZE(segs) / 2);
+
+	while (count) {
+		batch = MIN(count, per_cmd);
+		for (i = 0; i < batch; i++) {
+			segs[2 * i].read = 0;
+			segs[2 * i].chip = chip;
+			segs[2 * i].buf = (uint8_t *)&regs[i];
+			segs[2 * i].len = 1;
+			segs[2 * i + 1].read = 1;
+			segs[2 * i + 1].chip = chip;
+			segs[2 * i + 1].buf = &data[i];
+			segs[2 * i + 1].len = 1;
+		}
+		if (i2c_transfer(&bus->ops, segs, 2 * batch))
+			return -1;
+		regs += batch;
+		data += batch;
+		count -= batch;
+	}
+	return 0;
+}
+
 int cros_ec_tunnel_i2c_protect(CrosECTunnelI2c *bus)
 {
 	struct ec_params_i2c_passthru_protect params = {
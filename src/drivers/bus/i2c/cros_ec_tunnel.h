@@ -27,6 +27,9 @@ typedef struct CrosECTunnelI2c {
 	uint8_t response_buf[256];
 } CrosECTunnelI2c;
 
+/* Most I2C messages a single passthru command can carry. */
+#define CROS_EC_TUNNEL_MAX_SEGS	64
+
 /* -----------------------------------------------------------------------
  * cros ec tunnel i2c init function.
  *   devidx: EC devidx (should be 0)
@@ -42,6 +45,18 @@ CrosECTunnelI2c *new_cros_ec_tunnel_i2c(CrosEc *ec,
  * to blocking all accesses on the given bus).
  */
 int cros_ec_tunnel_i2c_protect(CrosECTunnelI2c *bus);
+
+/* -----------------------------------------------------------------------
+ * Vectored register access. Unlike i2c_write_regs()/i2c_read_regs(), as
+ * many registers as fit are packed into each EC_CMD_I2C_PASSTHRU, one I2C
+ * message per register, separated by repeated starts.
+ *   Returns: 0 on success, -1 on error
+ */
+int cros_ec_tunnel_i2c_write_regs(CrosECTunnelI2c *bus, uint8_t chip,
+				  const I2cWriteVec *cmds, size_t count);
+int cros_ec_tunnel_i2c_read_regs(CrosECTunnelI2c *bus, uint8_t chip,
+				 const uint8_t *regs, size_t count,
+				 uint8_t *data);
 int cros_ec_tunnel_i2c_protect_status(CrosECTunnelI2c *bus, int *status);
 
 #endif
@@ -19,6 +19,12 @@
 typedef struct I2sOps
 {
 	int (*send)(struct I2sOps *me, uint32_t *data, unsigned int length);
+
+	// (Optional) Plays the data over and over in the background until
+	// stop_loop is called. The data must stay valid until then.
+	int (*start_loop)(struct I2sOps *me, uint32_t *data,
+			  unsigned int length);
+	int (*stop_loop)(struct I2sOps *me);
 } I2sOps;
 
 #endif /* __DRIVERS_BUS_I2S_I2S_H__ */
@@ -131,12 +131,62 @@ static int mtk_i2s_send(I2sOps *me, uint32_t *data, unsigned int length)
 	return 0;
 }
 
+/*
+ * DL1 is a ring buffer already: the AFE wraps around to dl1_base after
+ * reading dl1_end, so a loop is just a buffer which holds the data once.
+ */
+static int mtk_i2s_start_loop(I2sOps *me, uint32_t *data, unsigned int length)
+{
+	MtkI2s *bus = container_of(me, MtkI2s, ops);
+	Mt8173I2sRegs *regs = bus->regs;
+	uintptr_t buf_size, buf_base;
+
+	if (bus->loop_buffer)
+		me->stop_loop(me);
+
+	mtk_i2s_init(bus);
+
+	buf_size = length * sizeof(uint32_t);
+	bus->loop_buffer = dma_memalign(16, buf_size);
+	buf_base = (uintptr_t)bus->loop_buffer;
+	memcpy(bus->loop_buffer, data, buf_size);
+
+	I2S_LOG("loop len = %d base = %lx end = %lx\n",
+		length, buf_base, buf_base + buf_size - 1);
+
+	writel(buf_base, &regs->dl1_base);
+	writel(buf_base + buf_size - 1, &regs->dl1_end);
+
+	/* enable DL1 */
+	setbits_le32(&regs->dac_con0, 1 << 1);
+
+	return 0;
+}
+
+static int mtk_i2s_stop_loop(I2sOps *me)
+{
+	MtkI2s *bus = container_of(me, MtkI2s, ops);
+	Mt8173I2sRegs *regs = bus->regs;
+
+	if (!bus->loop_buffer)
+		return 0;
+
+	/* stop DL1 */
+	clrbits_le32(&regs->dac_con0, 1 << 1);
+
+	free(bus->loop_buffer);
+	bus->loop_buffer = NULL;
+	return 0;
+}
+
 MtkI2s *new_mtk_i2s(uintptr_t base, uint32_t channels, uint32_t rate)
 {
 	MtkI2s *bus = xzalloc(sizeof(*bus));
 
 	bus->component.ops.enable = &mtk_i2s_enable;
 	bus->ops.send = &mtk_i2s_send;
+	bus->ops.start_loop = &mtk_i2s_start_loop;
+	bus->ops.stop_loop = &mtk_i2s_stop_loop;
 	bus->regs = (void *)base;
 	bus->channels = channels;
 	bus->rate = rate;
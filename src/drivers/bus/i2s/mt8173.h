@@ -111,6 +111,7 @@ typedef struct {
 	uint32_t initialized;
 	uint32_t channels;
 	uint32_t rate;
+	uint32_t *loop_buffer;
 } MtkI2s;
 
 MtkI2s *new_mtk_i2s(uintptr_t base, uint32_t channels, uint32_t rate);
@@ -71,16 +71,23 @@ static int tegra_i2s_init(TegraI2s *bus)
 	return 0;
 }
 
-static int tegra_i2s_send(I2sOps *me, uint32_t *data, unsigned int length)
+static int tegra_i2s_prepare(TegraI2s *bus)
 {
-	TegraI2s *bus = container_of(me, TegraI2s, ops);
-
 	if (!bus->initialized) {
 		if (tegra_i2s_init(bus))
 			return -1;
 		else
 			bus->initialized = 1;
 	}
+	return 0;
+}
+
+static int tegra_i2s_send(I2sOps *me, uint32_t *data, unsigned int length)
+{
+	TegraI2s *bus = container_of(me, TegraI2s, ops);
+
+	if (tegra_i2s_prepare(bus))
+		return -1;
 
 	// Note the FIFO on Tegra 1x4 (provided by APBIF inside AHUB) has its
 	// own flow control to start FIFO only when the accumulated data has
@@ -93,6 +100,31 @@ static int tegra_i2s_send(I2sOps *me, uint32_t *data, unsigned int length)
 	return 0;
 }
 
+static int tegra_i2s_start_loop(I2sOps *me, uint32_t *data,
+				unsigned int length)
+{
+	TegraI2s *bus = container_of(me, TegraI2s, ops);
+
+	if (tegra_i2s_prepare(bus))
+		return -1;
+
+	tegra_i2s_transmit_enable(bus->regs, 1);
+	if (bus->fifo->start_loop(bus->fifo, data, length * sizeof(*data))) {
+		tegra_i2s_transmit_enable(bus->regs, 0);
+		return -1;
+	}
+	return 0;
+}
+
+static int tegra_i2s_stop_loop(I2sOps *me)
+{
+	TegraI2s *bus = container_of(me, TegraI2s, ops);
+
+	int res = bus->fifo->stop_loop(bus->fifo);
+	tegra_i2s_transmit_enable(bus->regs, 0);
+	return res;
+}
+
 int tegra_i2s_set_cif_tx_ctrl(TegraI2s *i2s, uint32_t value)
 {
 	// The CIF is not really part of I2S -- it's for Audio Hub to control
@@ -109,6 +141,10 @@ TegraI2s *new_tegra_i2s(uintptr_t regs, TxFifoOps *fifo, int id,
 {
 	TegraI2s *bus = xzalloc(sizeof(*bus));
 	bus->ops.send = &tegra_i2s_send;
+	if (fifo->start_loop && fifo->stop_loop) {
+		bus->ops.start_loop = &tegra_i2s_start_loop;
+		bus->ops.stop_loop = &tegra_i2s_stop_loop;
+	}
 	bus->regs = (TegraI2sRegs *)regs;
 	bus->fifo = fifo;
 	bus->id = id;
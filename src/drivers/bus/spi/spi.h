@@ -16,12 +16,23 @@
 
 #include <stdint.h>
 
+/* Data line counts, as used in SpiOps.rx_lines */
+#define SPI_RX_DUAL	(1 << 2)
+#define SPI_RX_QUAD	(1 << 4)
+
 typedef struct SpiOps
 {
 	int (*start)(struct SpiOps *me);
 	int (*transfer)(struct SpiOps *me, void *in, const void *out,
 			uint32_t size);
 	int (*stop)(struct SpiOps *me);
+	/*
+	 * Optional: receive size bytes over 2 or 4 data lines. The controllers
+	 * supporting this set the matching SPI_RX_* bits in rx_lines.
+	 */
+	int (*transfer_rx)(struct SpiOps *me, void *in, uint32_t size,
+			   unsigned lines);
+	uint32_t rx_lines;
 } SpiOps;
 
 #endif /* __DRIVERS_BUS_SPI_SPI_H__ */
@@ -31,6 +31,14 @@ typedef struct TxFifoOps {
 	// (Optional) Returns the current size of data already in FIFO.
 	size_t (*size)(struct TxFifoOps *me);
 
+	// (Optional) Keeps feeding the buffer into FIFO over and over in the
+	// background until stop_loop is called. The buffer must stay valid
+	// until then. Returns 0 on success, otherwise -1.
+	int (*start_loop)(struct TxFifoOps *me, const void *buf, size_t len);
+
+	// (Optional) Stops feeding the buffer passed to start_loop.
+	int (*stop_loop)(struct TxFifoOps *me);
+
 } TxFifoOps;
 
 typedef struct RxFifoOps {
@@ -150,7 +150,8 @@ static int __must_check write_reg(Anx3429 *me, uint8_t reg, uint8_t data)
 }
 
 /**
- * issue a series of i2c writes to ANX_FW_I2C_ADDR
+ * issue a series of i2c writes to ANX_FW_I2C_ADDR, batched into as few
+ * EC passthru commands as possible
  *
  * @param me	device context
  * @param cmds	vector of i2c reg write commands
@@ -161,7 +162,8 @@ static int __must_check write_reg(Anx3429 *me, uint8_t reg, uint8_t data)
 static int __must_check write_regs(Anx3429 *me,
 				   const I2cWriteVec *cmds, const size_t count)
 {
-	return i2c_write_regs(&me->bus->ops, ANX_FW_I2C_ADDR, cmds, count);
+	return cros_ec_tunnel_i2c_write_regs(me->bus, ANX_FW_I2C_ADDR,
+					     cmds, count);
 }
 
 static int __must_check write_block(Anx3429 *me, uint8_t reg,
@@ -333,10 +335,12 @@ static int __must_check anx3429_otp_prog72raw(Anx3429 *me,
 
 	if (write_block(me, R_OTP_DATA_IN_0, word72, 8) != 0)
 		return -1;
-	if (write_reg(me, R_OTP_ECC_IN, word72[8]) != 0)
-		return -1;
 
-	if (write_reg(me, R_OTP_CTL_1, R_OTP_CTL_1_WRITE_OTP72RAW) != 0)
+	const I2cWriteVec wc[] = {
+		{ R_OTP_ECC_IN, word72[8] },
+		{ R_OTP_CTL_1, R_OTP_CTL_1_WRITE_OTP72RAW },
+	};
+	if (write_regs(me, wc, ARRAY_SIZE(wc)) != 0)
 		return -1;
 
 	t0_us = timer_us(0);
@@ -28,6 +28,7 @@
 #include <vboot_api.h>
 
 #include "base/container_of.h"
+#include "base/init_funcs.h"
 #include "drivers/ec/cros/message.h"
 #include "drivers/ec/cros/ec.h"
 
@@ -348,6 +349,79 @@ int ec_command(CrosEc *me, int cmd, int cmd_version,
 				cmd_version, dout, dout_len, din, din_len);
 }
 
+typedef struct {
+	int cmd;
+	int cmd_version;
+	void *params;
+	int params_size;
+	void *resp;
+	int resp_size;
+	int result;
+	ListNode list_node;
+} CrosEcCachedResponse;
+
+/*
+ * Like ec_command(), but for commands whose response only depends on the
+ * parameters and can't change until the EC reboots. Successful responses are
+ * kept and handed out again without talking to the EC.
+ */
+static int ec_command_cached(CrosEc *me, int cmd, int cmd_version,
+			     const void *dout, int dout_len,
+			     void *din, int din_len)
+{
+	CrosEcCachedResponse *entry;
+	int result;
+
+	list_for_each(entry, me->response_cache, list_node) {
+		if (entry->cmd != cmd || entry->cmd_version != cmd_version ||
+		    entry->params_size != dout_len ||
+		    entry->resp_size != din_len ||
+		    (dout_len && memcmp(entry->params, dout, dout_len)))
+			continue;
+
+		if (din_len)
+			memcpy(din, entry->resp, din_len);
+		return entry->result;
+	}
+
+	result = ec_command(me, cmd, cmd_version, dout, dout_len,
+			    din, din_len);
+	if (result < 0)
+		return result;
+
+	entry = xzalloc(sizeof(*entry));
+	entry->cmd = cmd;
+	entry->cmd_version = cmd_version;
+	if (dout_len) {
+		entry->params = xmalloc(dout_len);
+		memcpy(entry->params, dout, dout_len);
+	}
+	entry->params_size = dout_len;
+	if (din_len) {
+		entry->resp = xmalloc(din_len);
+		memcpy(entry->resp, din, din_len);
+	}
+	entry->resp_size = din_len;
+	entry->result = result;
+	list_insert_after(&entry->list_node, &me->response_cache);
+
+	return result;
+}
+
+void cros_ec_invalidate_cache(CrosEc *me)
+{
+	while (me->response_cache.next) {
+		CrosEcCachedResponse *entry = container_of(
+			me->response_cache.next, CrosEcCachedResponse,
+			list_node);
+
+		list_remove(&entry->list_node);
+		free(entry->params);
+		free(entry->resp);
+		free(entry);
+	}
+}
+
 static CrosEc *get_main_ec(void)
 {
 	assert(vboot_ec[0]);
@@ -371,8 +445,8 @@ static int get_cmd_versions(CrosEc *me, int cmd, uint32_t *pmask)
 
 	p.cmd = cmd;
 
-	if (ec_command(me, EC_CMD_GET_CMD_VERSIONS,
-		       1, &p, sizeof(p), &r, sizeof(r)) != sizeof(r))
+	if (ec_command_cached(me, EC_CMD_GET_CMD_VERSIONS,
+			      1, &p, sizeof(p), &r, sizeof(r)) != sizeof(r))
 		return -1;
 
 	*pmask = r.version_mask;
@@ -487,6 +561,19 @@ static enum ec_flash_region vboot_to_ec_region(enum VbSelectFirmware_t select)
 	}
 }
 
+static int ec_vboot_hash_start(CrosEc *me, uint32_t offset,
+			       struct ec_response_vboot_hash *resp)
+{
+	struct ec_params_vboot_hash p = { 0 };
+
+	p.cmd = EC_VBOOT_HASH_START;
+	p.hash_type = EC_VBOOT_HASH_TYPE_SHA256;
+	p.offset = offset;
+
+	return ec_command(me, EC_CMD_VBOOT_HASH, 0, &p, sizeof(p),
+			  resp, sizeof(*resp));
+}
+
 static VbError_t vboot_hash_image(VbootEcOps *vbec,
 				  enum VbSelectFirmware_t select,
 				  const uint8_t **hash, int *hash_size)
@@ -519,12 +606,7 @@ static VbError_t vboot_hash_image(VbootEcOps *vbec,
 			      "Compute one...\n", __func__, resp.status,
 			      resp.size);
 
-			p.cmd = EC_VBOOT_HASH_START;
-			p.hash_type = EC_VBOOT_HASH_TYPE_SHA256;
-			p.nonce_size = 0;
-
-			if (ec_command(me, EC_CMD_VBOOT_HASH, 0, &p,
-				       sizeof(p), &resp, sizeof(resp)) < 0)
+			if (ec_vboot_hash_start(me, hash_offset, &resp) < 0)
 				return VBERROR_UNKNOWN;
 
 			recalc_requested = 1;
@@ -560,6 +642,45 @@ static VbError_t vboot_hash_image(VbootEcOps *vbec,
 	return VBERROR_SUCCESS;
 }
 
+/*
+ * Software sync needs the hash of the active RW image of every EC. Get each EC
+ * started on it as early as possible, so that the hashing overlaps with the
+ * rest of initialization instead of vboot_hash_image() having to wait for it.
+ * The EC only keeps one hash around, so the update region (if any) is still
+ * hashed on demand.
+ */
+static int cros_ec_precompute_hashes(void)
+{
+	if (!CONFIG_EC_SOFTWARE_SYNC)
+		return 0;
+
+	for (int devidx = 0; devidx < NUM_MAX_VBOOT_ECS; devidx++) {
+		VbootEcOps *vbec = vboot_ec[devidx];
+		struct ec_params_vboot_hash p = { 0 };
+		struct ec_response_vboot_hash resp;
+
+		if (!vbec || vbec->hash_image != vboot_hash_image)
+			continue;
+
+		CrosEc *me = container_of(vbec, CrosEc, vboot);
+
+		/* Leave a finished or running hash alone. */
+		p.cmd = EC_VBOOT_HASH_GET;
+		p.offset = EC_VBOOT_HASH_OFFSET_ACTIVE;
+		if (ec_command(me, EC_CMD_VBOOT_HASH, 0, &p, sizeof(p),
+			       &resp, sizeof(resp)) < 0 ||
+		    resp.status != EC_VBOOT_HASH_STATUS_NONE)
+			continue;
+
+		printf("EC%d: Starting hash of active image.\n", devidx);
+		ec_vboot_hash_start(me, EC_VBOOT_HASH_OFFSET_ACTIVE, &resp);
+	}
+
+	return 0;
+}
+
+INIT_FUNC(cros_ec_precompute_hashes);
+
 /**
  * Run internal tests on the ChromeOS EC interface.
  *
@@ -591,6 +712,10 @@ static int ec_reboot(CrosEc *me, enum ec_reboot_cmd cmd, uint8_t flags)
 		       &p, sizeof(p), NULL, 0) < 0)
 		return -1;
 
+	/* Whatever image comes up next may answer differently. */
+	if (cmd != EC_REBOOT_DISABLE_JUMP)
+		cros_ec_invalidate_cache(me);
+
 	/* Do we expect our command to immediately reboot the EC? */
 	if (cmd != EC_REBOOT_DISABLE_JUMP &&
 	    !(flags & EC_REBOOT_FLAG_ON_AP_SHUTDOWN)) {
@@ -659,6 +784,11 @@ int cros_ec_interrupt_pending(void)
 	return 1;	// Always assume we have input if no GPIO set
 }
 
+int cros_ec_interrupt_available(void)
+{
+	return get_main_ec()->interrupt_gpio != NULL;
+}
+
 int cros_ec_mkbp_info(struct ec_response_mkbp_info *info)
 {
 	if (ec_command(get_main_ec(), EC_CMD_MKBP_INFO, 0, NULL, 0, info,
@@ -777,9 +907,10 @@ static int ec_flash_offset(CrosEc *me, enum ec_flash_region region,
 	int ret;
 
 	p.region = region;
-	ret = ec_command(me,
-			 EC_CMD_FLASH_REGION_INFO, EC_VER_FLASH_REGION_INFO,
-			 &p, sizeof(p), &r, sizeof(r));
+	ret = ec_command_cached(me,
+				EC_CMD_FLASH_REGION_INFO,
+				EC_VER_FLASH_REGION_INFO,
+				&p, sizeof(p), &r, sizeof(r));
 	if (ret != sizeof(r))
 		return -1;
 
@@ -867,8 +998,8 @@ static int ec_flash_write_burst_size(CrosEc *me)
 	 * Determine step size.  This must be a multiple of the write block
 	 * size, and must also fit into the host parameter buffer.
 	 */
-	if (ec_command(me, EC_CMD_FLASH_INFO, 0,
-		       NULL, 0, &info, sizeof(info)) != sizeof(info))
+	if (ec_command_cached(me, EC_CMD_FLASH_INFO, 0,
+			      NULL, 0, &info, sizeof(info)) != sizeof(info))
 		return 0;
 
 	return (pdata_max_size / info.write_block_size) *
@@ -915,6 +1046,104 @@ static int ec_flash_write(CrosEc *me, const uint8_t *data, uint32_t offset,
 	return 0;
 }
 
+/**
+ * Read data from the flash
+ *
+ * Read an arbitrary amount of data from the EC flash, split into chunks that
+ * fit into the host response buffer.
+ *
+ * @param data		Pointer to buffer to read into
+ * @param offset	Offset within flash to read from
+ * @param size		Number of bytes to read
+ * @return 0 if ok, -1 on error
+ */
+static int ec_flash_read(CrosEc *me, uint8_t *data, uint32_t offset,
+			 uint32_t size)
+{
+	struct ec_params_flash_read p;
+	uint32_t burst = EC_PROTO2_MAX_PARAM_SIZE;
+	uint32_t end = offset + size;
+
+	if (me->proto3_response_size)
+		burst = me->proto3_response_size -
+			sizeof(struct ec_host_response);
+
+	for (p.offset = offset; p.offset < end; p.offset += p.size) {
+		p.size = MIN(end - p.offset, burst);
+		if (ec_command(me, EC_CMD_FLASH_READ, 0, &p, sizeof(p),
+			       data, p.size) != p.size)
+			return -1;
+		data += p.size;
+	}
+
+	return 0;
+}
+
+/**
+ * Return flash erase block size, or 0 if it can't be determined
+ */
+static uint32_t ec_flash_erase_block_size(CrosEc *me)
+{
+	struct ec_response_flash_info info;
+
+	if (ec_command_cached(me, EC_CMD_FLASH_INFO, 0,
+			      NULL, 0, &info, sizeof(info)) != sizeof(info))
+		return 0;
+
+	return info.erase_block_size;
+}
+
+static int ec_flash_is_erased(const uint8_t *data, uint32_t size)
+{
+	while (size--)
+		if (*data++ != 0xff)
+			return 0;
+	return 1;
+}
+
+/**
+ * Check whether a block of flash already holds the expected contents
+ *
+ * @param buf		Scratch buffer of at least size bytes
+ * @param offset	Offset within flash of the block
+ * @param size		Size of the block
+ * @param image		Expected contents of the block
+ * @param image_size	Number of bytes of image in the block; the rest of the
+ *			block is expected to be erased
+ * @return 1 if the block matches, 0 if it differs or can't be read
+ */
+static int ec_flash_block_matches(CrosEc *me, uint8_t *buf, uint32_t offset,
+				  uint32_t size, const uint8_t *image,
+				  uint32_t image_size)
+{
+	if (ec_flash_read(me, buf, offset, size))
+		return 0;
+
+	return !memcmp(buf, image, image_size) &&
+		ec_flash_is_erased(buf + image_size, size - image_size);
+}
+
+/**
+ * Erase a range of flash and write back the part of the image it covers
+ *
+ * @param offset	Offset of the range within the region
+ * @param size		Size of the range
+ * @return 0 if ok, -1 on error
+ */
+static int ec_flash_rewrite(CrosEc *me, uint32_t region_offset,
+			    uint32_t offset, uint32_t size,
+			    const uint8_t *image, uint32_t image_size)
+{
+	if (ec_flash_erase(me, region_offset + offset, size))
+		return -1;
+
+	if (offset >= image_size)
+		return 0;
+
+	return ec_flash_write(me, image + offset, region_offset + offset,
+			      MIN(size, image_size - offset));
+}
+
 static VbError_t vboot_set_region_protection(CrosEc *me,
 	enum VbSelectFirmware_t select, int enable)
 {
@@ -975,19 +1204,52 @@ static VbError_t vboot_update_image(VbootEcOps *vbec,
 		return VBERROR_INVALID_PARAMETER;
 
 	/*
-	 * Erase the entire region, so that the EC doesn't see any garbage
-	 * past the new image if it's smaller than the current image.
-	 *
-	 * TODO: could optimize this to erase just the current image, since
-	 * presumably everything past that is 0xff's.  But would still need to
-	 * round up to the nearest multiple of erase size.
+	 * Compare the region against the new image one erase block at a time
+	 * and only erase and rewrite the blocks that differ. Everything past
+	 * the end of the image must be erased, so that the EC doesn't see any
+	 * garbage if the new image is smaller than the current one. If the
+	 * erase block size isn't usable, fall back to rewriting the whole
+	 * region.
 	 */
-	if (ec_flash_erase(me, region_offset, region_size))
-		return VBERROR_UNKNOWN;
+	uint32_t block = ec_flash_erase_block_size(me);
+	if (!block || region_offset % block || region_size % block) {
+		if (ec_flash_rewrite(me, region_offset, 0, region_size,
+				     image, image_size))
+			return VBERROR_UNKNOWN;
+		return VBERROR_SUCCESS;
+	}
 
-	/* Write the image */
-	if (ec_flash_write(me, image, region_offset, image_size))
-		return VBERROR_UNKNOWN;
+	uint8_t *buf = xmalloc(block);
+	uint32_t dirty_start = 0, dirty_size = 0, rewritten = 0;
+	uint32_t off;
+
+	for (off = 0; off <= region_size; off += block) {
+		uint32_t image_left = off < image_size ? image_size - off : 0;
+
+		if (off < region_size &&
+		    !ec_flash_block_matches(me, buf, region_offset + off, block,
+					    image + off, MIN(block, image_left))) {
+			if (!dirty_size)
+				dirty_start = off;
+			dirty_size += block;
+			continue;
+		}
+
+		/* Flush the run of differing blocks ending here. */
+		if (!dirty_size)
+			continue;
+		if (ec_flash_rewrite(me, region_offset, dirty_start,
+				     dirty_size, image, image_size)) {
+			free(buf);
+			return VBERROR_UNKNOWN;
+		}
+		rewritten += dirty_size;
+		dirty_size = 0;
+	}
+
+	free(buf);
+	printf("EC: rewrote %u of %u bytes of flash region\n",
+	       rewritten, region_size);
 
 	return VBERROR_SUCCESS;
 }
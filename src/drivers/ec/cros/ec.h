@@ -21,6 +21,7 @@
 
 #include <stdint.h>
 
+#include "base/list.h"
 #include "drivers/ec/vboot_ec.h"
 #include "drivers/ec/cros/commands.h"
 #include "drivers/gpio/gpio.h"
@@ -85,6 +86,9 @@ typedef struct CrosEc
 	int proto3_request_size;
 	struct ec_host_response *proto3_response;
 	int proto3_response_size;
+	// Responses to commands whose results can't change until the EC
+	// reboots.
+	ListNode response_cache;
 } CrosEc;
 
 /**
@@ -103,6 +107,17 @@ int ec_command(CrosEc *ec, int cmd, int cmd_version,
 	       const void *dout, int dout_len,
 	       void *din, int din_len);
 
+/**
+ * Forget all cached EC command responses.
+ *
+ * This happens automatically when the EC is rebooted or jumps to another
+ * image through this driver, but anything else that resets the EC behind our
+ * back needs to call it.
+ *
+ * @param ec		EC device
+ */
+void cros_ec_invalidate_cache(CrosEc *ec);
+
 /*
  * Hard-code the number of columns we happen to know we have right now.  It
  * would be more correct to call cros_ec_mkbp_info() at startup and determine
@@ -146,6 +161,14 @@ int cros_ec_get_next_event(struct ec_response_get_next_event *event);
  */
 int cros_ec_interrupt_pending(void);
 
+/**
+ * Check whether cros_ec_interrupt_pending() can actually tell if the EC has
+ * something for us, i.e. whether an interrupt GPIO is configured.
+ *
+ * @return non-zero if an interrupt GPIO is configured
+ */
+int cros_ec_interrupt_available(void);
+
 /**
  * Read information about the keyboard matrix
  *
@@ -84,16 +84,41 @@ static void mec_io_bytes(int write, uint8_t *data, uint16_t port, int size) {
 	/* Skip bytes in case of misaligned port */
 	io_addr = MEC_EMI_EC_DATA_B0 + (port & 0x3);
 	while (i < size) {
-		while (io_addr <= MEC_EMI_EC_DATA_B3) {
-			if (write)
-				outb(data[i++], io_addr++);
-			else
-				data[i++] = inb(io_addr++);
-
-			port++;
-			/* Extra bounds check in case of misaligned length */
+		/*
+		 * Move whole words with a single 32-bit access, which hits
+		 * B0 through B3 and auto-increments just like four byte
+		 * accesses do.
+		 */
+		if (access_mode == ACCESS_TYPE_LONG_AUTO_INCREMENT &&
+		    io_addr == MEC_EMI_EC_DATA_B0 && size - i >= 4) {
+			uint32_t word;
+
+			if (write) {
+				memcpy(&word, &data[i], sizeof(word));
+				outl(word, io_addr);
+			} else {
+				word = inl(io_addr);
+				memcpy(&data[i], &word, sizeof(word));
+			}
+			i += sizeof(word);
+			port += sizeof(word);
 			if (i == size)
 				return;
+		} else {
+			while (io_addr <= MEC_EMI_EC_DATA_B3) {
+				if (write)
+					outb(data[i++], io_addr++);
+				else
+					data[i++] = inb(io_addr++);
+
+				port++;
+				/*
+				 * Extra bounds check in case of misaligned
+				 * length
+				 */
+				if (i == size)
+					return;
+			}
 		}
 
 		/*
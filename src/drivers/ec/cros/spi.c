@@ -38,6 +38,8 @@ static const uint64_t CsCooldownUs = 200;
 static const uint64_t AcceptTimeoutUs = 5 * 1000;
 // How long we'll wait in total for a valid packet response from the EC.
 static const uint64_t ProcessTimeoutUs = 1000 * 1000;
+// How many bytes to clock in at a time while waiting for the response.
+enum { FrameScanBytes = 32 };
 
 static void stop_bus(CrosEcSpiBus *bus)
 {
@@ -45,41 +47,56 @@ static void stop_bus(CrosEcSpiBus *bus)
 	bus->last_transfer = timer_us(0);
 }
 
-static int wait_for_frame(CrosEcSpiBus *bus, uint16_t command)
+/*
+ * Wait for the EC to start its response, scanning the incoming bytes in
+ * chunks instead of one transfer per byte. Any response bytes that were
+ * clocked in after EC_SPI_FRAME_START as part of the last chunk are copied to
+ * data, and their number is returned in received. At most size such bytes
+ * will be read.
+ */
+static int wait_for_frame(CrosEcSpiBus *bus, uint16_t command,
+			  uint8_t *data, uint32_t size, uint32_t *received)
 {
 	uint64_t start = timer_us(0);
 	int accept_timeout_us = AcceptTimeoutUs;
 	int accepted = 0;
-	uint8_t byte;
+	uint8_t chunk[FrameScanBytes];
+	uint32_t chunk_len = MIN(sizeof(chunk), size + 1);
 
 	// STM32 does XIP and can't handle interrupts timely while erasing.
 	if (command == EC_CMD_GET_COMMS_STATUS)
 		accept_timeout_us = ProcessTimeoutUs;
 
 	while (1) {
-		if (bus->spi->transfer(bus->spi, &byte, NULL, 1))
+		if (bus->spi->transfer(bus->spi, chunk, NULL, chunk_len))
 			return -1;
 
-		switch (byte) {
-		case EC_SPI_FRAME_START:
-			// Done waiting, can start receiving response packet.
-			return 0;
-		case EC_SPI_PROCESSING:
-			// EC has accepted our command and started processing.
-			// It should continue sending 0xFA from here on out,
-			// but we don't want to rely on that since the NPCX has
-			// a bug corrupting every 256th byte it sends.
-			accepted = 1;
-			break;
-		case EC_SPI_RX_BAD_DATA:
-			printf("EC: Claims to have received bad data.\n");
-			return -1;
-		case EC_SPI_NOT_READY:
-			printf("EC: Was not ready to receive host command.\n");
-			return -1;
-		default:
-			// Probably EC_SPI_RECEIVING, or random garbage.
-			break;
+		for (uint32_t i = 0; i < chunk_len; i++) {
+			switch (chunk[i]) {
+			case EC_SPI_FRAME_START:
+				// Done waiting, keep whatever part of the
+				// response packet came in with this chunk.
+				*received = chunk_len - i - 1;
+				memcpy(data, &chunk[i + 1], *received);
+				return 0;
+			case EC_SPI_PROCESSING:
+				// EC has accepted our command and started
+				// processing. It should continue sending 0xFA
+				// from here on out, but we don't want to rely
+				// on that since the NPCX has a bug corrupting
+				// every 256th byte it sends.
+				accepted = 1;
+				break;
+			case EC_SPI_RX_BAD_DATA:
+				printf("EC: Claims to have received bad data.\n");
+				return -1;
+			case EC_SPI_NOT_READY:
+				printf("EC: Was not ready to receive host command.\n");
+				return -1;
+			default:
+				// Probably EC_SPI_RECEIVING, or random garbage.
+				break;
+			}
 		}
 
 		uint64_t waited = timer_us(start);
@@ -97,10 +114,9 @@ static int wait_for_frame(CrosEcSpiBus *bus, uint16_t command)
 	}
 }
 
-static int send_packet(CrosEcBusOps *me, const void *dout, uint32_t dout_len,
-		       void *din, uint32_t din_len)
+static int start_bus(CrosEcSpiBus *bus)
 {
-	CrosEcSpiBus *bus = container_of(me, CrosEcSpiBus, ops);
+	uint64_t idle = timer_us(bus->last_transfer);
 
 	while (timer_us(bus->last_transfer) < CsCooldownUs)
 		;
@@ -108,9 +124,24 @@ static int send_packet(CrosEcBusOps *me, const void *dout, uint32_t dout_len,
 	if (bus->spi->start(bus->spi))
 		return -1;
 
-	// Allow EC to ramp up clock after being awaken.
+	// Allow EC to ramp up clock after being awoken. If it was talked to
+	// recently enough it can't have gone back to sleep, so don't bother.
 	// See chrome-os-partner:32223 for more details.
-	udelay(CONFIG_DRIVER_EC_CROS_SPI_WAKEUP_DELAY_US);
+	if (!bus->last_transfer ||
+	    idle >= CONFIG_DRIVER_EC_CROS_SPI_AWAKE_WINDOW_US)
+		udelay(CONFIG_DRIVER_EC_CROS_SPI_WAKEUP_DELAY_US);
+
+	return 0;
+}
+
+static int send_packet(CrosEcBusOps *me, const void *dout, uint32_t dout_len,
+		       void *din, uint32_t din_len)
+{
+	CrosEcSpiBus *bus = container_of(me, CrosEcSpiBus, ops);
+	uint32_t received;
+
+	if (start_bus(bus))
+		return -1;
 
 	if (bus->spi->transfer(bus->spi, NULL, dout, dout_len)) {
 		stop_bus(bus);
@@ -120,12 +151,14 @@ static int send_packet(CrosEcBusOps *me, const void *dout, uint32_t dout_len,
 	// Wait until the EC is ready. Do not print warnings for lack of reply
 	// if the command is HELLO -- we use that to test if the EC is ready.
 	const struct ec_host_request *rq = dout;
-	if (wait_for_frame(bus, rq->command)) {
+	if (wait_for_frame(bus, rq->command, din, din_len, &received)) {
 		stop_bus(bus);
 		return -1;
 	}
 
-	if (bus->spi->transfer(bus->spi, din, NULL, din_len)) {
+	if (received < din_len &&
+	    bus->spi->transfer(bus->spi, (uint8_t *)din + received, NULL,
+			       din_len - received)) {
 		stop_bus(bus);
 		return -1;
 	}
@@ -178,16 +211,9 @@ static int send_command(CrosEcBusOps *me, uint8_t cmd, int cmd_version,
 	// Send the output.
 	cros_ec_dump_data("out", -1, bus->buf, out_bytes);
 
-	while (timer_us(bus->last_transfer) < CsCooldownUs)
-		;
-
-	if (bus->spi->start(bus->spi))
+	if (start_bus(bus))
 		return -1;
 
-	// Allow EC to ramp up clock after being awoken.
-	// See chrome-os-partner:32223 for more details.
-	udelay(CONFIG_DRIVER_EC_CROS_SPI_WAKEUP_DELAY_US);
-
 	if (bus->spi->transfer(bus->spi, NULL, bus->buf, out_bytes)) {
 		stop_bus(bus);
 		return -1;
@@ -195,14 +221,18 @@ static int send_command(CrosEcBusOps *me, uint8_t cmd, int cmd_version,
 
 	// Wait until the EC is ready. Do not print warnings for lack of reply
 	// if the command is HELLO -- we use that to test if the EC is ready.
-	if (wait_for_frame(bus, cmd)) {
+	uint32_t received;
+	bytes = bus->buf;
+	if (wait_for_frame(bus, cmd, bytes, CROS_EC_SPI_IN_HDR_SIZE,
+			   &received)) {
 		stop_bus(bus);
 		return -1;
 	}
 
-	// Read the response code and the data length.
-	bytes = bus->buf;
-	if (bus->spi->transfer(bus->spi, bytes, NULL, 2)) {
+	// Read the rest of the response code and the data length.
+	if (received < CROS_EC_SPI_IN_HDR_SIZE &&
+	    bus->spi->transfer(bus->spi, bytes + received, NULL,
+			       CROS_EC_SPI_IN_HDR_SIZE - received)) {
 		stop_bus(bus);
 		return -1;
 	}
@@ -71,6 +71,13 @@
 #define PS_FW_RD_CHUNK		16
 #define PS_FW_WR_CHUNK		12
 
+/*
+ * bytes verified per update step, small enough that other chips being
+ * updated at the same time don't doze off while we're busy
+ */
+
+#define PS_FW_VERIFY_STEP	0x400
+
 #define SPI_CMD_WRITE_STATUS_REG	0x01
 #define SPI_CMD_PROG_PAGE		0x02
 #define SPI_CMD_READ_DATA		0x03
@@ -148,7 +155,8 @@ static int __must_check write_reg(Ps8751 *me,
 }
 
 /**
- * issue a series of i2c writes
+ * issue a series of i2c writes, batched into as few EC passthru
+ * commands as possible
  *
  * @param me	device context
  * @param cmds	vector of i2c reg write commands
@@ -159,7 +167,7 @@ static int __must_check write_reg(Ps8751 *me,
 static int __must_check write_regs(Ps8751 *me, uint8_t chip,
 				   const I2cWriteVec *cmds, const size_t count)
 {
-	return i2c_write_regs(&me->bus->ops, chip, cmds, count);
+	return cros_ec_tunnel_i2c_write_regs(me->bus, chip, cmds, count);
 }
 
 /**
@@ -179,7 +187,8 @@ static int __must_check read_reg(Ps8751 *me,
 }
 
 /**
- * issue a series of i2c reads
+ * issue a series of i2c reads, batched into as few EC passthru
+ * commands as possible
  *
  * @param me	device context
  * @param regs	vector of i2c regs to read read
@@ -194,7 +203,7 @@ static int __must_check read_regs(Ps8751 *me,
 				  const size_t count,
 				  uint8_t *data)
 {
-	return i2c_read_regs(&me->bus->ops, chip, regs, count, data);
+	return cros_ec_tunnel_i2c_read_regs(me->bus, chip, regs, count, data);
 }
 
 /**
@@ -389,29 +398,6 @@ static int __must_check ps8751_spi_cmd_enable_writes(Ps8751 *me)
 	return 0;
 }
 
-/*
- * wait for "erase/program command finished" as seen by the ps8751
- */
-
-static int __must_check ps8751_spi_wait_prog_cmd(Ps8751 *me)
-{
-	uint8_t busy;
-	uint64_t t0_us;
-
-	t0_us = timer_us(0);
-	do {
-		if (read_reg(me, SLAVE2, P2_SPI_STATUS, &busy) != 0)
-			return -1;
-		if ((busy & 0x3f) == 0x00) {
-			/* {chip,sector} erase, program cmd finished */
-			return 0;
-		}
-	} while (timer_us(t0_us) < PS_WIP_TIMEOUT_US);
-	printf("ps8751.%d: flash prog/erase timeout after %ums\n",
-	       me->ec_pd_id, USEC_TO_MSEC(PS_SPI_TIMEOUT_US));
-	return -1;
-}
-
 /**
  * read SPI flash status register
  *
@@ -547,17 +533,29 @@ static int __must_check ps8751_spi_flash_unlock(Ps8751 *me)
 }
 
 /*
- * wait for "erase/program command finished" as seen by the ps8751
- * then, wait for the WIP (write-in-progress) bit to clear on the
- * flash part itself.
+ * check whether the last erase/program command is still running: first
+ * as seen by the ps8751, then the WIP (write-in-progress) bit on the
+ * flash part itself.  doesn't wait, so the caller can get on with
+ * something else in the meantime.
+ *
+ * @param me		device context
+ * @param busy		set non-zero if the command hasn't finished
+ * @return 0 if ok, -1 on error
  */
 
-static int __must_check ps8751_spi_wait_rom_ready(Ps8751 *me)
+static int __must_check ps8751_spi_rom_busy(Ps8751 *me, int *busy)
 {
-	if (ps8751_spi_wait_prog_cmd(me) != 0)
+	uint8_t status;
+
+	if (read_reg(me, SLAVE2, P2_SPI_STATUS, &status) != 0)
 		return -1;
-	if (ps8751_spi_wait_wip(me) != 0)
+	if ((status & 0x3f) != 0x00) {
+		*busy = 1;
+		return 0;
+	}
+	if (ps8751_spi_cmd_read_status(me, &status) != 0)
 		return -1;
+	*busy = status & SPI_STATUS_WIP;
 	return 0;
 }
 
@@ -783,7 +781,10 @@ static int __must_check ps8751_spi_setup_cmd24(Ps8751 *me,
 
 /**
  * issue a single flash sector erase command to
- * erase PARADE_FW_SECTOR (4KB) bytes.
+ * erase PARADE_FW_SECTOR (4KB) bytes.  doesn't wait
+ * for the erase to finish, see ps8751_spi_rom_busy().
+ *
+ * assumes SPI interface has been enabled for programming.
  *
  * @param me		device context
  * @param offset	device byte offset, but containing
@@ -791,7 +792,7 @@ static int __must_check ps8751_spi_setup_cmd24(Ps8751 *me,
  * @return 0 if ok, -1 on error
  */
 
-static int __must_check ps8751_sector_erase(Ps8751 *me, uint32_t offset)
+static int __must_check ps8751_sector_erase_start(Ps8751 *me, uint32_t offset)
 {
 	if (ps8751_spi_cmd_enable_writes(me) != 0)
 		return -1;
@@ -806,110 +807,59 @@ static int __must_check ps8751_sector_erase(Ps8751 *me, uint32_t offset)
 		return -1;
 	if (ps8751_spi_fifo_wait_busy(me) != 0)
 		return -1;
-	if (ps8751_spi_wait_rom_ready(me) != 0)
-		return -1;
 	return 0;
 }
 
 /**
- * erase a chunk of flash.  offset and data_size must be sector aligned,
- * which is PARADE_FW_SECTOR (4KB).
- *
- * assumes SPI interface has been enabled for programming.
- *
- * @param me		device context
- * @param offset	device offset, 1st byte to erase
- * @param data_size	number of bytes to erase
- * @return 0 if ok, -1 on error
- */
-
-static int __must_check ps8751_erase(Ps8751 *me,
-				     uint32_t offset, uint32_t data_size)
-{
-	uint32_t end = offset + data_size;
-	int rval = 0;
-	uint64_t t0_us;
-
-	debug("offset 0x%06x size %u\n", offset, data_size);
-
-	t0_us = timer_us(0);
-	for (; offset < end; offset += PARADE_FW_SECTOR) {
-		if (ps8751_sector_erase(me, offset) != VBERROR_SUCCESS)
-			rval = -1;
-	}
-	printf("ps8751.%d: erased %uKB in %ums\n",
-	       me->ec_pd_id,
-	       data_size >> 10,
-	       (unsigned)USEC_TO_MSEC(timer_us(t0_us)));
-	return rval;
-}
-
-/**
- * program flash with new data
+ * issue a flash program command for the next chunk of data, clipped at
+ * PS_FW_WR_CHUNK and the flash page boundary.  doesn't wait for the
+ * program to finish, see ps8751_spi_rom_busy().
  *
  * flash is assumed to be erased
  * the MPU is assumed to be stopped (highly recommended)
  * the SPI bus and flash are write-enabled
  *
  * @param me		device context
- * @param fw_start	flash device offset to program
+ * @param a24		flash device offset to program
  * @param data		addr of data to write
- * @param data_size	size of data to write
- * @return 0 if ok, -1 on error
+ * @param data_size	size of data left to write
+ * @return number of bytes being programmed, -1 on error
  */
 
-static int __must_check ps8751_program(Ps8751 *me,
-				       const uint32_t fw_start,
-				       const uint8_t *data, int data_size)
+static int __must_check ps8751_program_chunk_start(Ps8751 *me,
+						   const uint32_t a24,
+						   const uint8_t *data,
+						   size_t data_size)
 {
-	uint32_t data_offset;
-	uint64_t t0_us;
-	int chunk;
-
-	printf("ps8751.%d: programming %uKB...\n",
-	       me->ec_pd_id,
-	       data_size >> 10);
-
-	t0_us = timer_us(0);
-	for (data_offset = 0;
-	     data_offset < data_size;
-	     data_offset += chunk) {
-		chunk = MIN(PS_FW_WR_CHUNK, data_size - data_offset);
-		/* clip at flash page boundary */
-		int page_offset = (fw_start + data_offset) & SPI_PAGE_MASK;
-		chunk = MIN(chunk, SPI_PAGE_SIZE - page_offset);
+	int chunk = MIN(PS_FW_WR_CHUNK, data_size);
+	/* clip at flash page boundary */
+	chunk = MIN(chunk, SPI_PAGE_SIZE - (a24 & SPI_PAGE_MASK));
 
-		if (ps8751_spi_cmd_enable_writes(me) != 0)
-			return -1;
-
-		if (ps8751_spi_setup_cmd24(me,
-					   SPI_CMD_PROG_PAGE,
-					   fw_start + data_offset) != 0) {
-			return -1;
-		}
-		for (int i = 0; i < chunk; ++i) {
-			if (write_reg(me, SLAVE2,
-				      P2_WR_FIFO, data[data_offset + i]) != 0)
-				return -1;
-		}
+	if (ps8751_spi_cmd_enable_writes(me) != 0)
+		return -1;
 
-		const I2cWriteVec wr[] = {
-			{ P2_SPI_LEN, (4 + chunk - 1) },
-			{ P2_SPI_CTRL,
-			  P2_SPI_CTRL_NOREAD|P2_SPI_CTRL_TRIGGER },
-		};
-		if (write_regs(me, SLAVE2, wr, ARRAY_SIZE(wr)) != 0)
-			return -1;
-		if (ps8751_spi_fifo_wait_busy(me) != 0)
-			return -1;
-		if (ps8751_spi_wait_rom_ready(me) != 0)
-			return -1;
+	/* cmd, address, data, length and trigger in one go */
+	I2cWriteVec wr[4 + PS_FW_WR_CHUNK + 2] = {
+		{ P2_WR_FIFO, SPI_CMD_PROG_PAGE },
+		{ P2_WR_FIFO, a24 >> 16 },
+		{ P2_WR_FIFO, a24 >>  8 },
+		{ P2_WR_FIFO, a24 },
+	};
+	int n = 4;
+	for (int i = 0; i < chunk; ++i) {
+		wr[n].reg = P2_WR_FIFO;
+		wr[n++].val = data[i];
 	}
-	printf("ps8751.%d: programmed %uKB in %us\n",
-	       me->ec_pd_id,
-	       data_size >> 10,
-	       (unsigned)USEC_TO_SEC(timer_us(t0_us)));
-	return 0;
+	wr[n].reg = P2_SPI_LEN;
+	wr[n++].val = 4 + chunk - 1;
+	wr[n].reg = P2_SPI_CTRL;
+	wr[n++].val = P2_SPI_CTRL_NOREAD|P2_SPI_CTRL_TRIGGER;
+
+	if (write_regs(me, SLAVE2, wr, n) != 0)
+		return -1;
+	if (ps8751_spi_fifo_wait_busy(me) != 0)
+		return -1;
+	return chunk;
 }
 
 /**
@@ -927,14 +877,15 @@ static int __must_check ps8751_verify(Ps8751 *me,
 				      const uint8_t *data, size_t data_size)
 {
 	uint64_t deadline = 0;
-	uint8_t readback;
-	uint64_t t0_us;
+	uint8_t readback[PS_FW_RD_CHUNK];
+	uint8_t rd_fifo[PS_FW_RD_CHUNK];
 	uint32_t data_offset;
 	int chunk;
 
 	debug("offset 0x%06x size %u\n", fw_addr, data_size);
 
-	t0_us = timer_us(0);
+	memset(rd_fifo, P2_RD_FIFO, sizeof(rd_fifo));
+
 	for (data_offset = 0;
 	     data_offset < data_size;
 	     data_offset += chunk) {
@@ -942,12 +893,14 @@ static int __must_check ps8751_verify(Ps8751 *me,
 
 		if (ps8751_keep_awake(me, &deadline) != 0)
 			return -1;
-		if (ps8751_spi_setup_cmd24(me, SPI_CMD_READ_DATA,
-					   fw_addr + data_offset) != 0) {
-			return -1;
-		}
 
+		/* cmd, address, length and trigger in one go */
+		const uint32_t a24 = fw_addr + data_offset;
 		const I2cWriteVec rd[] = {
+			{ P2_WR_FIFO, SPI_CMD_READ_DATA },
+			{ P2_WR_FIFO, a24 >> 16 },
+			{ P2_WR_FIFO, a24 >>  8 },
+			{ P2_WR_FIFO, a24 },
 			{ P2_SPI_LEN,
 			  ((chunk - 1) << 4) | (4 - 1) },
 			{ P2_SPI_CTRL, P2_SPI_CTRL_TRIGGER },
@@ -956,23 +909,19 @@ static int __must_check ps8751_verify(Ps8751 *me,
 			return -1;
 		if (ps8751_spi_fifo_wait_busy(me) != 0)
 			return -1;
+		if (read_regs(me, SLAVE2, rd_fifo, chunk, readback) != 0)
+			return -1;
 		for (int i = 0; i < chunk; ++i) {
-			if (read_reg(me, SLAVE2, P2_RD_FIFO, &readback) != 0)
-				return -1;
-			if (readback != data[data_offset + i]) {
+			if (readback[i] != data[data_offset + i]) {
 				printf("ps8751.%d: mismatch at offset 0x%06x "
 				       "0x%02x != 0x%02x (expected)\n",
 				       me->ec_pd_id,
 				       fw_addr + data_offset + i,
-				       readback, data[data_offset + i]);
+				       readback[i], data[data_offset + i]);
 				return -1;
 			}
 		}
 	}
-	printf("ps8751.%d: verified %uKB in %us\n",
-	       me->ec_pd_id,
-	       data_size >> 10,
-	       (unsigned)USEC_TO_SEC(timer_us(t0_us)));
 	return 0;
 }
 
@@ -1090,62 +1039,6 @@ static void ps8751_dump_flash(Ps8751 *me,
 	       "================================\n");
 }
 
-/**
- * install a new firmware image, replacing whatever was there before,
- * then verify installed data.
- *
- * the MPU is assumed to be stopped (highly recommended)
- * the SPI bus and flash are write-enabled
- *
- * @param me		device context
- * @param data		addr of firmware blob to install
- * @param data_size	size of firmware blob to install
- * @return 0 if ok, -1 on error
- */
-
-static int ps8751_reflash(Ps8751 *me, const uint8_t *data, size_t data_size)
-{
-	int status;
-
-	debug("data %8p len %u\n", data, data_size);
-
-	status = ps8751_erase(me, PARADE_FW_START, data_size);
-	if (status != 0) {
-		printf("ps8751.%d: chip erase failed\n", me->ec_pd_id);
-		return -1;
-	}
-	/*
-	 * quick sanity check to see if we modified flash
-	 * we'll do a full verify after programming
-	 */
-	status = ps8751_verify(me, PARADE_FW_START,
-			       erased_bytes,
-			       MIN(data_size, sizeof(erased_bytes)));
-	if (status != 0) {
-		printf("ps8751.%d: chip erase verify failed\n", me->ec_pd_id);
-		return -1;
-	}
-
-	if (PS8751_DEBUG > 0) {
-		debug("start post erase 7s delay...\n");
-		mdelay(7 * 1000);
-		debug("end post erase delay\n");
-	}
-
-	if (PS8751_DEBUG >= 2)
-		ps8751_dump_flash(me, PARADE_FW_START,
-				  PARADE_FW_END - PARADE_FW_START);
-	status = ps8751_program(me, PARADE_FW_START, data, data_size);
-	if (PS8751_DEBUG >= 2)
-		ps8751_dump_flash(me, PARADE_FW_START, PARADE_TEST_FW_SIZE);
-	if (status != 0) {
-		printf("ps8751.%d: chip program failed\n", me->ec_pd_id);
-		return -1;
-	}
-
-	return ps8751_verify(me, PARADE_FW_START, data, data_size);
-}
-
 /*
  * reading the firmware takes about 15-20 secs, so we'll just use the
  * firmware rev as a trivial hash.
@@ -1175,34 +1068,70 @@ static VbError_t ps8751_check_hash(const VbootAuxFwOps *vbaux,
 	return VBERROR_SUCCESS;
 }
 
-static int ps8751_halt_and_flash(Ps8751 *me,
-				 const uint8_t *image, size_t image_size)
-{
-	int status = -1;
+/*
+ * the update is split into steps which only kick off a flash erase or
+ * program command and return, so several chips can be updated at once:
+ *
+ * ps8751_update_start() halts the MPU and unlocks the flash,
+ * ps8751_update_poll() then erases, programs and verifies the new image
+ * one step per call, and puts everything back once it's done.
+ */
 
-	if (ps8751_disable_mpu(me) != 0)
-		return -1;
-	if (ps8751_spi_flash_unlock(me) != 0)
-		goto enable_mpu;
-	debug("unlock_spi_bus returned\n");
-	if (ps8751_spi_flash_identify(me) == 0 &&
-	    ps8751_reflash(me, image, image_size) == 0)
-		status = 0;
+enum ps8751_unwind {
+	PS_UNWIND_LOCK,
+	PS_UNWIND_ENABLE_MPU,
+	PS_UNWIND_HIDE_I2C,
+	PS_UNWIND_PD_RESUME,
+};
 
-	if (ps8751_spi_flash_lock(me) != 0)
-		status = -1;
+/**
+ * undo the update setup, starting at the given stage
+ *
+ * @param me		device context
+ * @param status	status of the update so far
+ * @param from		first stage to undo
+ * @return final status of the update
+ */
+
+static VbError_t ps8751_update_unwind(Ps8751 *me, VbError_t status,
+				      enum ps8751_unwind from)
+{
+	switch (from) {
+	case PS_UNWIND_LOCK:
+		if (ps8751_spi_flash_lock(me) != 0)
+			status = VBERROR_UNKNOWN;
+		/* fall through */
+	case PS_UNWIND_ENABLE_MPU:
+		if (ps8751_enable_mpu(me) != 0)
+			status = VBERROR_UNKNOWN;
+		/* fall through */
+	case PS_UNWIND_HIDE_I2C:
+		if (ps8751_hide_i2c(me) != 0)
+			status = VBERROR_UNKNOWN;
+		/* fall through */
+	case PS_UNWIND_PD_RESUME:
+		if (ps8751_ec_pd_resume(me) != 0)
+			status = VBERROR_UNKNOWN;
+	}
+
+	if (ps8751_capture_device_id(me, 1) != 0)
+		status = VBERROR_UNKNOWN;
 
-enable_mpu:
-	if (ps8751_enable_mpu(me) != 0)
-		return -1;
 	return status;
 }
 
-static VbError_t ps8751_update_image(const VbootAuxFwOps *vbaux,
+static void ps8751_update_next_phase(Ps8751 *me,
+				     enum ps8751_update_phase phase)
+{
+	me->update.phase = phase;
+	me->update.offset = 0;
+	me->update.phase_start_us = timer_us(0);
+}
+
+static VbError_t ps8751_update_start(const VbootAuxFwOps *vbaux,
 				     const uint8_t *image, size_t image_size)
 {
 	Ps8751 *me = container_of(vbaux, Ps8751, fw_ops);
-	VbError_t status = VBERROR_UNKNOWN;
 	int protected;
 
 	debug("call...\n");
@@ -1219,24 +1148,149 @@ static VbError_t ps8751_update_image(const VbootAuxFwOps *vbaux,
 		return VBERROR_UNKNOWN;
 
 	if (ps8751_wake_i2c(me) != 0)
-		goto pd_resume;
+		return ps8751_update_unwind(me, VBERROR_UNKNOWN,
+					    PS_UNWIND_PD_RESUME);
+	if (!ps8751_is_fw_compatible(me, image) ||
+	    ps8751_disable_mpu(me) != 0)
+		return ps8751_update_unwind(me, VBERROR_UNKNOWN,
+					    PS_UNWIND_HIDE_I2C);
+	if (ps8751_spi_flash_unlock(me) != 0)
+		return ps8751_update_unwind(me, VBERROR_UNKNOWN,
+					    PS_UNWIND_ENABLE_MPU);
+	debug("unlock_spi_bus returned\n");
+	if (ps8751_spi_flash_identify(me) != 0)
+		return ps8751_update_unwind(me, VBERROR_UNKNOWN,
+					    PS_UNWIND_LOCK);
 
-	if (!ps8751_is_fw_compatible(me, image))
-		goto hide_i2c;
-	if (ps8751_halt_and_flash(me, image, image_size) == 0)
-		status = VBERROR_SUCCESS;
+	debug("data %8p len %u\n", image, image_size);
 
-hide_i2c:
-	if (ps8751_hide_i2c(me) != 0)
-		status = VBERROR_UNKNOWN;
+	me->update.image = image;
+	me->update.image_size = image_size;
+	me->update.busy = 0;
+	ps8751_update_next_phase(me, PS_UPDATE_ERASE);
+	return VBERROR_SUCCESS;
+}
 
-pd_resume:
-	if (ps8751_ec_pd_resume(me) != 0)
-		status = VBERROR_UNKNOWN;
+static VbError_t ps8751_update_poll(const VbootAuxFwOps *vbaux, int *done)
+{
+	Ps8751 *me = container_of(vbaux, Ps8751, fw_ops);
+	const uint8_t *image = me->update.image;
+	size_t image_size = me->update.image_size;
+	uint32_t offset = me->update.offset;
+	int busy;
+
+	*done = 0;
+
+	/* wait for the last erase/program command without blocking */
+	if (me->update.busy) {
+		if (ps8751_spi_rom_busy(me, &busy) != 0)
+			goto fail;
+		if (busy) {
+			if (timer_us(me->update.op_start_us) <
+			    PS_WIP_TIMEOUT_US)
+				return VBERROR_SUCCESS;
+			printf("ps8751.%d: flash prog/erase timeout after "
+			       "%ums\n", me->ec_pd_id,
+			       USEC_TO_MSEC(PS_WIP_TIMEOUT_US));
+			goto fail;
+		}
+		me->update.busy = 0;
+	}
 
-	if (ps8751_capture_device_id(me, 1) != 0)
-		status = VBERROR_UNKNOWN;
+	switch (me->update.phase) {
+	case PS_UPDATE_ERASE:
+		if (offset < image_size) {
+			if (ps8751_sector_erase_start(
+				    me, PARADE_FW_START + offset) != 0)
+				goto fail;
+			me->update.offset += PARADE_FW_SECTOR;
+			break;
+		}
+		printf("ps8751.%d: erased %uKB in %ums\n",
+		       me->ec_pd_id, offset >> 10,
+		       (unsigned)USEC_TO_MSEC(
+			       timer_us(me->update.phase_start_us)));
+		/*
+		 * quick sanity check to see if we modified flash
+		 * we'll do a full verify after programming
+		 */
+		if (ps8751_verify(me, PARADE_FW_START, erased_bytes,
+				  MIN(image_size, sizeof(erased_bytes))) != 0) {
+			printf("ps8751.%d: chip erase verify failed\n",
+			       me->ec_pd_id);
+			goto fail;
+		}
+		if (PS8751_DEBUG > 0) {
+			debug("start post erase 7s delay...\n");
+			mdelay(7 * 1000);
+			debug("end post erase delay\n");
+		}
+		if (PS8751_DEBUG >= 2)
+			ps8751_dump_flash(me, PARADE_FW_START,
+					  PARADE_FW_END - PARADE_FW_START);
+		printf("ps8751.%d: programming %uKB...\n",
+		       me->ec_pd_id, image_size >> 10);
+		ps8751_update_next_phase(me, PS_UPDATE_PROGRAM);
+		return VBERROR_SUCCESS;
+
+	case PS_UPDATE_PROGRAM:
+		if (offset < image_size) {
+			int chunk = ps8751_program_chunk_start(
+				me, PARADE_FW_START + offset,
+				image + offset, image_size - offset);
+			if (chunk < 0)
+				goto fail;
+			me->update.offset += chunk;
+			break;
+		}
+		printf("ps8751.%d: programmed %uKB in %us\n",
+		       me->ec_pd_id, image_size >> 10,
+		       (unsigned)USEC_TO_SEC(
+			       timer_us(me->update.phase_start_us)));
+		if (PS8751_DEBUG >= 2)
+			ps8751_dump_flash(me, PARADE_FW_START,
+					  PARADE_TEST_FW_SIZE);
+		ps8751_update_next_phase(me, PS_UPDATE_VERIFY);
+		return VBERROR_SUCCESS;
+
+	case PS_UPDATE_VERIFY:
+		if (offset < image_size) {
+			size_t chunk = MIN(PS_FW_VERIFY_STEP,
+					   image_size - offset);
+			if (ps8751_verify(me, PARADE_FW_START + offset,
+					  image + offset, chunk) != 0)
+				goto fail;
+			me->update.offset += chunk;
+			return VBERROR_SUCCESS;
+		}
+		printf("ps8751.%d: verified %uKB in %us\n",
+		       me->ec_pd_id, image_size >> 10,
+		       (unsigned)USEC_TO_SEC(
+			       timer_us(me->update.phase_start_us)));
+		*done = 1;
+		return ps8751_update_unwind(me, VBERROR_SUCCESS,
+					    PS_UNWIND_LOCK);
+	}
+
+	me->update.busy = 1;
+	me->update.op_start_us = timer_us(0);
+	return VBERROR_SUCCESS;
+
+fail:
+	printf("ps8751.%d: chip update failed\n", me->ec_pd_id);
+	*done = 1;
+	return ps8751_update_unwind(me, VBERROR_UNKNOWN, PS_UNWIND_LOCK);
+}
+
+static VbError_t ps8751_update_image(const VbootAuxFwOps *vbaux,
+				     const uint8_t *image, size_t image_size)
+{
+	VbError_t status;
+	int done = 0;
 
+	status = ps8751_update_start(vbaux, image, image_size);
+	while (status == VBERROR_SUCCESS && !done)
+		status = ps8751_update_poll(vbaux, &done);
 	return status;
 }
 
@@ -1259,6 +1313,8 @@ static const VbootAuxFwOps ps8751_fw_ops = {
 	.fw_hash_name = "ps8751_a3.hash",
 	.check_hash = ps8751_check_hash,
 	.update_image = ps8751_update_image,
+	.update_start = ps8751_update_start,
+	.update_poll = ps8751_update_poll,
 	.protect = ps8751_protect,
 };
 
@@ -35,6 +35,21 @@ typedef struct Ps8751
 		uint16_t device;
 		uint8_t fw_rev;
 	} chip;
+
+	/* progress of a firmware update, see ps8751_update_poll() */
+	struct {
+		const uint8_t *image;
+		size_t image_size;
+		enum ps8751_update_phase {
+			PS_UPDATE_ERASE,
+			PS_UPDATE_PROGRAM,
+			PS_UPDATE_VERIFY,
+		} phase;
+		uint32_t offset;
+		int busy;
+		uint64_t op_start_us;
+		uint64_t phase_start_us;
+	} update;
 } Ps8751;
 
 Ps8751 *new_ps8751(CrosECTunnelI2c *bus, int ec_pd_id);
@@ -18,9 +18,12 @@
 
 #include <cbfs.h>
 
+#include "drivers/flash/cbfs.h"
+
 static struct {
 	const VbootAuxFwOps *fw_ops;
 	VbAuxFwUpdateSeverity_t severity;
+	const uint8_t *image;	/* mapped while a split-phase update runs */
 } vboot_aux_fw[NUM_MAX_VBOOT_AUX_FW];
 
 static int vboot_aux_fw_count = 0;
@@ -59,15 +62,18 @@ static VbError_t check_dev_fw_hash(const VbootAuxFwOps *aux_fw,
 {
 	const void *want_hash;
 	size_t want_size;
+	VbError_t status;
 
 	/* find bundled fw hash */
-	want_hash = cbfs_get_file_content(
+	want_hash = cbfs_index_map_file(
 		CBFS_DEFAULT_MEDIA,
 		aux_fw->fw_hash_name, CBFS_TYPE_RAW, &want_size);
 	if (want_hash == NULL)
 		die("%s missing from CBFS\n", aux_fw->fw_hash_name);
 
-	return aux_fw->check_hash(aux_fw, want_hash, want_size, severity);
+	status = aux_fw->check_hash(aux_fw, want_hash, want_size, severity);
+	cbfs_index_unmap_file(want_hash);
+	return status;
 }
 
 /**
@@ -107,14 +113,86 @@ static VbError_t apply_dev_fw(const VbootAuxFwOps *aux_fw)
 {
 	const uint8_t *want_data;
 	size_t want_size;
+	VbError_t status;
 
 	/* find bundled fw */
-	want_data = cbfs_get_file_content(
+	want_data = cbfs_index_map_file(
 		CBFS_DEFAULT_MEDIA,
 		aux_fw->fw_image_name, CBFS_TYPE_RAW, &want_size);
 	if (want_data == NULL)
 		die("%s missing from CBFS\n", aux_fw->fw_image_name);
-	return aux_fw->update_image(aux_fw, want_data, want_size);
+	status = aux_fw->update_image(aux_fw, want_data, want_size);
+	cbfs_index_unmap_file(want_data);
+	return status;
+}
+
+/**
+ * apply device firmware updates that support update_start()/update_poll()
+ * all at the same time, so that one chip's erase and program waits overlap
+ * with work on the others.  total time approaches that of the slowest
+ * chip instead of the sum of all of them.
+ *
+ * every started update is run to completion even if another one fails.
+ *
+ * @return VBERROR_... error of the first failed update, VBERROR_SUCCESS
+ *         if all of them succeeded.
+ */
+
+static VbError_t apply_dev_fw_interleaved(void)
+{
+	VbError_t status = VBERROR_SUCCESS;
+	VbError_t result;
+	int active = 0;
+	size_t want_size;
+	int done;
+
+	for (int i = 0; i < vboot_aux_fw_count; ++i) {
+		const VbootAuxFwOps *aux_fw = vboot_aux_fw[i].fw_ops;
+
+		if (vboot_aux_fw[i].severity == VB_AUX_FW_NO_UPDATE ||
+		    !aux_fw->update_start)
+			continue;
+
+		/* find bundled fw */
+		vboot_aux_fw[i].image = cbfs_index_map_file(
+			CBFS_DEFAULT_MEDIA,
+			aux_fw->fw_image_name, CBFS_TYPE_RAW, &want_size);
+		if (vboot_aux_fw[i].image == NULL)
+			die("%s missing from CBFS\n", aux_fw->fw_image_name);
+
+		result = aux_fw->update_start(aux_fw, vboot_aux_fw[i].image,
+					      want_size);
+		if (result != VBERROR_SUCCESS) {
+			cbfs_index_unmap_file(vboot_aux_fw[i].image);
+			vboot_aux_fw[i].image = NULL;
+			if (status == VBERROR_SUCCESS)
+				status = result;
+			continue;
+		}
+		active++;
+	}
+
+	while (active) {
+		for (int i = 0; i < vboot_aux_fw_count; ++i) {
+			const VbootAuxFwOps *aux_fw = vboot_aux_fw[i].fw_ops;
+
+			if (vboot_aux_fw[i].image == NULL)
+				continue;
+
+			result = aux_fw->update_poll(aux_fw, &done);
+			if (!done)
+				continue;
+
+			cbfs_index_unmap_file(vboot_aux_fw[i].image);
+			vboot_aux_fw[i].image = NULL;
+			active--;
+			if (result != VBERROR_SUCCESS &&
+			    status == VBERROR_SUCCESS)
+				status = result;
+		}
+	}
+
+	return status;
 }
 
 /**
@@ -130,14 +208,28 @@ VbError_t update_vboot_aux_fw(void)
 	VbAuxFwUpdateSeverity_t severity;
 	VbError_t status;
 
+	/* devices that can only be updated one by one go first */
 	for (int i = 0; i < vboot_aux_fw_count; ++i) {
 		const VbootAuxFwOps *aux_fw;
 
 		aux_fw = vboot_aux_fw[i].fw_ops;
-		if (vboot_aux_fw[i].severity != VB_AUX_FW_NO_UPDATE) {
+		if (vboot_aux_fw[i].severity != VB_AUX_FW_NO_UPDATE &&
+		    !aux_fw->update_start) {
 			status = apply_dev_fw(aux_fw);
 			if (status != VBERROR_SUCCESS)
 				return status;
+		}
+	}
+
+	status = apply_dev_fw_interleaved();
+	if (status != VBERROR_SUCCESS)
+		return status;
+
+	for (int i = 0; i < vboot_aux_fw_count; ++i) {
+		const VbootAuxFwOps *aux_fw;
+
+		aux_fw = vboot_aux_fw[i].fw_ops;
+		if (vboot_aux_fw[i].severity != VB_AUX_FW_NO_UPDATE) {
 			status = check_dev_fw_hash(aux_fw, &severity);
 			if (status != VBERROR_SUCCESS)
 				return status;
@@ -28,6 +28,17 @@ struct VbootAuxFwOps {
 	VbError_t (*update_image)(const VbootAuxFwOps *me,
 				  const uint8_t *image, size_t image_size);
 	VbError_t (*protect)(const VbootAuxFwOps *me);
+	/*
+	 * Optional split-phase version of update_image(), which lets
+	 * several chips be updated at the same time. update_start() gets
+	 * the update going, then update_poll() is called repeatedly to
+	 * advance it without waiting on the chip. It sets *done once the
+	 * update has finished and returns its status then. The image must
+	 * stay around until that point.
+	 */
+	VbError_t (*update_start)(const VbootAuxFwOps *me,
+				  const uint8_t *image, size_t image_size);
+	VbError_t (*update_poll)(const VbootAuxFwOps *me, int *done);
 	const char *fw_image_name;
 	const char *fw_hash_name;
 };
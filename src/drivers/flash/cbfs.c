@@ -17,7 +17,9 @@
 
 #include <libpayload.h>
 #include <cbfs.h>
+#include <sysinfo.h>
 #include "image/fmap.h"
+#include "drivers/flash/cbfs.h"
 #include "drivers/flash/flash.h"
 
 /* flash as CBFS media. */
@@ -129,3 +131,392 @@ struct cbfs_media *cbfs_ro_media(void)
 
 	return media;
 }
+
+/*
+ * CBFS directory index. The first lookup on a media walks all file headers
+ * once and records where each file lives, so that later lookups go straight
+ * to the file instead of rescanning the headers over the flash bus.
+ */
+
+#define CBFS_INDEX_BUCKETS	64
+
+typedef struct CbfsIndexEntry
+{
+	char *name;
+	uint32_t offset;	/* Flash offset of the file data. */
+	uint32_t size;
+	uint32_t type;
+	int compressed;
+	struct CbfsIndexEntry *next;
+} CbfsIndexEntry;
+
+typedef struct CbfsIndex
+{
+	struct cbfs_media *media;
+	/* Flash range covered by the index, used for invalidation. */
+	uint32_t start;
+	uint32_t end;
+	int valid;
+	/* Number of live cbfs_index_map_file() pointers into the range. */
+	int mapped;
+	CbfsIndexEntry *buckets[CBFS_INDEX_BUCKETS];
+	FlashWriteListener listener;
+	ListNode list_node;
+} CbfsIndex;
+
+static ListNode cbfs_indexes;
+
+static uint32_t cbfs_index_hash(const char *name)
+{
+	uint32_t hash = 5381;
+
+	while (*name)
+		hash = hash * 33 + (uint8_t)*name++;
+	return hash % CBFS_INDEX_BUCKETS;
+}
+
+static void cbfs_index_clear(CbfsIndex *index)
+{
+	CbfsIndexEntry *entry, *next;
+	int i;
+
+	for (i = 0; i < CBFS_INDEX_BUCKETS; i++) {
+		for (entry = index->buckets[i]; entry; entry = next) {
+			next = entry->next;
+			free(entry->name);
+			free(entry);
+		}
+		index->buckets[i] = NULL;
+	}
+	index->valid = 0;
+}
+
+static void cbfs_index_notify(FlashWriteListener *me, uint32_t offset,
+			      uint32_t size)
+{
+	CbfsIndex *index = container_of(me, CbfsIndex, listener);
+
+	if (offset >= index->end || offset + size <= index->start)
+		return;
+
+	if (index->mapped)
+		printf("CBFS: Flash write at %#x changes %d mapped files.\n",
+		       offset, index->mapped);
+	cbfs_index_clear(index);
+}
+
+/* Determine the flash range holding the CBFS, as libcbfs would. */
+static int cbfs_index_bounds(CbfsIndex *index, uint32_t *align)
+{
+	struct cbfs_media *media = index->media;
+	struct cbfs_header header;
+	int32_t rel_offset;
+	size_t offset;
+
+	if (media->context == NULL && lib_sysinfo.cbfs_offset &&
+	    lib_sysinfo.cbfs_size) {
+		index->start = lib_sysinfo.cbfs_offset;
+		index->end = index->start + lib_sysinfo.cbfs_size;
+		*align = CBFS_ALIGNMENT;
+		return 0;
+	}
+
+	if (media->context == NULL)
+		return -1;
+
+	if (media->read(media, &rel_offset, (size_t)-sizeof(rel_offset),
+			sizeof(rel_offset)) != sizeof(rel_offset))
+		return -1;
+	offset = (size_t)(ssize_t)rel_offset;
+	if (media->read(media, &header, offset, sizeof(header)) !=
+	    sizeof(header) || ntohl(header.magic) != CBFS_HEADER_MAGIC)
+		return -1;
+
+	index->start = ntohl(header.offset);
+	index->end = ntohl(header.romsize);
+	*align = ntohl(header.align);
+	/* The x86 bootblock sits at the end and has no file header. */
+	if (IS_ENABLED(CONFIG_ARCH_X86))
+		index->end -= ntohl(header.bootblocksize);
+	return *align ? 0 : -1;
+}
+
+/* Check the attributes of a file for a compression other than none. */
+static int cbfs_index_is_compressed(struct cbfs_media *media, size_t offset,
+				    const struct cbfs_file *file)
+{
+	struct cbfs_file_attr_compression attr;
+	uint32_t pos = ntohl(file->attributes_offset);
+	uint32_t end = ntohl(file->offset);
+
+	while (pos && pos + sizeof(attr) <= end) {
+		if (media->read(media, &attr, offset + pos, sizeof(attr)) !=
+		    sizeof(attr))
+			return 1;
+		if (ntohl(attr.tag) == CBFS_FILE_ATTR_TAG_COMPRESSION)
+			return ntohl(attr.compression) != CBFS_COMPRESS_NONE;
+		if (ntohl(attr.len) == 0)
+			break;
+		pos += ntohl(attr.len);
+	}
+	return 0;
+}
+
+static CbfsIndexEntry *cbfs_index_lookup(CbfsIndex *index, const char *name)
+{
+	CbfsIndexEntry *entry;
+
+	for (entry = index->buckets[cbfs_index_hash(name)]; entry;
+	     entry = entry->next) {
+		if (!strcmp(entry->name, name))
+			return entry;
+	}
+	return NULL;
+}
+
+static int cbfs_index_build(CbfsIndex *index)
+{
+	struct cbfs_media *media = index->media;
+	struct cbfs_file file;
+	CbfsIndexEntry *entry;
+	uint32_t align, offset, name_len, bucket;
+	const char *mapped;
+	char *name;
+
+	if (cbfs_index_bounds(index, &align))
+		return -1;
+
+	offset = index->start;
+	while (offset < index->end &&
+	       media->read(media, &file, offset, sizeof(file)) ==
+	       sizeof(file)) {
+		if (memcmp(CBFS_FILE_MAGIC, file.magic, sizeof(file.magic)) ||
+		    ntohl(file.offset) < sizeof(file)) {
+			offset = ALIGN_DOWN(offset, align) + align;
+			continue;
+		}
+
+		name_len = ntohl(file.offset) - sizeof(file);
+		mapped = media->map(media, offset + sizeof(file), name_len);
+		if (mapped == CBFS_MEDIA_INVALID_MAP_ADDRESS) {
+			cbfs_index_clear(index);
+			return -1;
+		}
+
+		offset += ntohl(file.offset);
+		name = strndup(mapped, name_len);
+		bucket = cbfs_index_hash(name);
+
+		/* Like libcbfs, the first file of a given name wins. */
+		if (cbfs_index_lookup(index, name)) {
+			free(name);
+			offset = ALIGN_UP(offset + ntohl(file.len), align);
+			continue;
+		}
+
+		entry = xzalloc(sizeof(*entry));
+		entry->name = name;
+		entry->offset = offset;
+		entry->size = ntohl(file.len);
+		entry->type = ntohl(file.type);
+		entry->compressed = cbfs_index_is_compressed(media,
+				offset - ntohl(file.offset), &file);
+		entry->next = index->buckets[bucket];
+		index->buckets[bucket] = entry;
+
+		offset = ALIGN_UP(entry->offset + entry->size, align);
+	}
+
+	index->valid = 1;
+	return 0;
+}
+
+/*
+ * Medias are told apart by the flash area they were created for, not by
+ * pointer, since e.g. cbfs_ro_media() hands every caller a new one.
+ */
+static int cbfs_same_media(struct cbfs_media *a, struct cbfs_media *b)
+{
+	FmapArea *area_a = a->context, *area_b = b->context;
+
+	if (!area_a || !area_b)
+		return area_a == area_b;
+	return area_a->offset == area_b->offset &&
+	       area_a->size == area_b->size;
+}
+
+static CbfsIndex *cbfs_find_index(struct cbfs_media *media)
+{
+	CbfsIndex *index;
+
+	list_for_each(index, cbfs_indexes, list_node) {
+		if (cbfs_same_media(index->media, media))
+			return index;
+	}
+	return NULL;
+}
+
+static CbfsIndex *cbfs_get_index(struct cbfs_media *media)
+{
+	static struct cbfs_media default_media;
+	CbfsIndex *index;
+
+	if (media == CBFS_DEFAULT_MEDIA) {
+		if (!default_media.read)
+			libpayload_init_default_cbfs_media(&default_media);
+		media = &default_media;
+	}
+
+	index = cbfs_find_index(media);
+	if (!index) {
+		index = xzalloc(sizeof(*index));
+		index->media = media;
+		index->listener.notify = cbfs_index_notify;
+		flash_add_write_listener(&index->listener);
+		list_insert_after(&index->list_node, &cbfs_indexes);
+	}
+
+	if (!index->valid && cbfs_index_build(index))
+		return NULL;
+	return index;
+}
+
+/* Find a file of the given type, or return NULL after logging why not. */
+static CbfsIndexEntry *cbfs_index_find(CbfsIndex *index, const char *name,
+				       int type)
+{
+	CbfsIndexEntry *entry = cbfs_index_lookup(index, name);
+
+	if (!entry) {
+		printf("CBFS: '%s' not found.\n", name);
+		return NULL;
+	}
+	if (entry->type != type) {
+		printf("CBFS: File '%s' is of type %x, expected %x.\n",
+		       name, entry->type, type);
+		return NULL;
+	}
+	return entry;
+}
+
+void *cbfs_index_get_file_content(struct cbfs_media *media, const char *name,
+				  int type, size_t *size)
+{
+	CbfsIndex *index;
+	CbfsIndexEntry *entry;
+	void *data, *content;
+
+	if (size)
+		*size = 0;
+
+	index = cbfs_get_index(media);
+	if (!index)
+		return cbfs_get_file_content(media, name, type, size);
+
+	entry = cbfs_index_find(index, name, type);
+	if (!entry)
+		return NULL;
+
+	/* libcbfs knows how to decompress, so let it handle those files. */
+	if (entry->compressed)
+		return cbfs_get_file_content(media, name, type, size);
+
+	data = flash_read(entry->offset, entry->size);
+	if (!data)
+		return NULL;
+
+	content = xmalloc(entry->size);
+	memcpy(content, data, entry->size);
+	if (size)
+		*size = entry->size;
+	return content;
+}
+
+/*
+ * Mappings handed out by cbfs_index_map_file(). Uncompressed files point
+ * straight into the flash driver's read buffer; the rest are heap copies
+ * that need to be freed on unmap.
+ */
+typedef struct CbfsMapping
+{
+	const void *data;
+	void *heap;
+	CbfsIndex *index;
+	ListNode list_node;
+} CbfsMapping;
+
+static ListNode cbfs_mappings;
+
+const void *cbfs_index_map_file(struct cbfs_media *media, const char *name,
+				int type, size_t *size)
+{
+	CbfsIndex *index;
+	CbfsIndexEntry *entry = NULL;
+	CbfsMapping *mapping;
+	const void *data;
+	void *heap = NULL;
+
+	if (size)
+		*size = 0;
+
+	index = cbfs_get_index(media);
+	if (index) {
+		entry = cbfs_index_find(index, name, type);
+		if (!entry)
+			return NULL;
+	}
+
+	if (entry && !entry->compressed) {
+		data = flash_read(entry->offset, entry->size);
+		if (!data)
+			return NULL;
+		if (size)
+			*size = entry->size;
+	} else {
+		heap = cbfs_get_file_content(media, name, type, size);
+		if (!heap)
+			return NULL;
+		data = heap;
+	}
+
+	mapping = xzalloc(sizeof(*mapping));
+	mapping->data = data;
+	mapping->heap = heap;
+	if (!heap) {
+		mapping->index = index;
+		index->mapped++;
+	}
+	list_insert_after(&mapping->list_node, &cbfs_mappings);
+	return data;
+}
+
+static CbfsMapping *cbfs_find_mapping(const void *data)
+{
+	CbfsMapping *mapping;
+
+	list_for_each(mapping, cbfs_mappings, list_node) {
+		if (mapping->data == data)
+			return mapping;
+	}
+	return NULL;
+}
+
+void cbfs_index_unmap_file(const void *data)
+{
+	CbfsMapping *mapping;
+
+	if (!data)
+		return;
+
+	mapping = cbfs_find_mapping(data);
+	if (!mapping) {
+		printf("CBFS: Unmapping unknown pointer %p.\n", data);
+		return;
+	}
+
+	if (mapping->index)
+		mapping->index->mapped--;
+	list_remove(&mapping->list_node);
+	free(mapping->heap);
+	free(mapping);
+}
@@ -18,9 +18,29 @@
 #ifndef __DRIVERS_FLASH_CBFS_H__
 #define __DRIVERS_FLASH_CBFS_H__
 
+#include <stddef.h>
+
 struct cbfs_media;
 
 /* Return a cbfs_media structure representing the RO CBFS -- NULL on error. */
 struct cbfs_media *cbfs_ro_media(void);
 
+/*
+ * Same as cbfs_get_file_content(), but look the file up in an index built on
+ * first use of the media. The index is dropped when its flash range is
+ * written. Returns a buffer the caller has to free.
+ */
+void *cbfs_index_get_file_content(struct cbfs_media *media, const char *name,
+				  int type, size_t *size);
+
+/*
+ * Return a read-only pointer to the content of a CBFS file without copying
+ * it, if the file is stored uncompressed. The pointer stays valid until it is
+ * passed to cbfs_index_unmap_file(); its content changes if the flash range
+ * is written in the meantime.
+ */
+const void *cbfs_index_map_file(struct cbfs_media *media, const char *name,
+				int type, size_t *size);
+void cbfs_index_unmap_file(const void *data);
+
 #endif
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <libpayload.h>
+#include <pci.h>
+#include <pci/pci.h>
+
+#include "base/container_of.h"
+#include "drivers/flash/fast_spi.h"
+
+/* SPIBAR registers */
+#define SPIBAR_BFPREG			0x00
+#define  BFPREG_BASE_MASK		0x7fff
+#define  BFPREG_LIMIT_SHIFT		16
+#define  BFPREG_LIMIT_MASK		(0x7fff << BFPREG_LIMIT_SHIFT)
+#define SPIBAR_HSFSTS_CTL		0x04
+#define  HSFSTS_FDONE			(1 << 0)
+#define  HSFSTS_FCERR			(1 << 1)
+#define  HSFSTS_AEL			(1 << 2)
+#define  HSFSTS_SCIP			(1 << 5)
+#define  HSFSTS_W1C_BITS		0xff
+#define  HSFSTS_FGO			(1 << 16)
+#define  HSFSTS_FCYCLE_SHIFT		17
+#define  HSFSTS_FCYCLE_MASK		(0xf << HSFSTS_FCYCLE_SHIFT)
+#define  HSFSTS_FDBC_SHIFT		24
+#define  HSFSTS_FDBC_MASK		(0x3f << HSFSTS_FDBC_SHIFT)
+#define SPIBAR_FADDR			0x08
+#define  FADDR_MASK			0x07ffffff
+#define SPIBAR_FDATA(n)			(0x10 + (n) * 4)
+
+enum {
+	HWSEQ_READ = 0,
+	HWSEQ_WRITE = 2,
+	HWSEQ_ERASE_4K = 3,
+	HWSEQ_ERASE_64K = 4,
+};
+
+/* Bytes moved per hardware sequencing cycle */
+#define HWSEQ_FIFO_SIZE			64
+/* Writes must not cross a flash page */
+#define HWSEQ_PAGE_SIZE			256
+#define HWSEQ_TIMEOUT_US		(5 * 1000 * 1000)
+
+static uint32_t fast_spi_read_reg(FastSpiFlash *flash, uint32_t reg)
+{
+	return read32((void *)(flash->mmio_base + reg));
+}
+
+static void fast_spi_write_reg(FastSpiFlash *flash, uint32_t reg,
+			       uint32_t val)
+{
+	write32((void *)(flash->mmio_base + reg), val);
+}
+
+/* Run one hardware sequencing cycle and wait for it to complete. */
+static int fast_spi_cycle(FastSpiFlash *flash, uint32_t cycle,
+			  uint32_t offset, uint32_t size)
+{
+	uint64_t start;
+	uint32_t hsfsts;
+
+	fast_spi_write_reg(flash, SPIBAR_FADDR, offset & FADDR_MASK);
+
+	hsfsts = HSFSTS_W1C_BITS | HSFSTS_FGO;
+	hsfsts |= (cycle << HSFSTS_FCYCLE_SHIFT) & HSFSTS_FCYCLE_MASK;
+	hsfsts |= ((size - 1) << HSFSTS_FDBC_SHIFT) & HSFSTS_FDBC_MASK;
+	fast_spi_write_reg(flash, SPIBAR_HSFSTS_CTL, hsfsts);
+
+	start = timer_us(0);
+	do {
+		hsfsts = fast_spi_read_reg(flash, SPIBAR_HSFSTS_CTL);
+
+		if (hsfsts & (HSFSTS_FCERR | HSFSTS_AEL)) {
+			printf("%s: cycle %d at %#x failed, status %#x\n",
+			       __func__, cycle, offset, hsfsts);
+			return -1;
+		}
+		if (hsfsts & HSFSTS_FDONE)
+			return 0;
+	} while (timer_us(start) < HWSEQ_TIMEOUT_US);
+
+	printf("%s: cycle %d at %#x timed out\n", __func__, cycle, offset);
+	return -1;
+}
+
+static int fast_spi_hwseq_read(FastSpiFlash *flash, uint8_t *data,
+			       uint32_t offset, uint32_t size)
+{
+	while (size) {
+		uint32_t len = MIN(size, HWSEQ_FIFO_SIZE);
+		uint32_t i, val;
+
+		if (fast_spi_cycle(flash, HWSEQ_READ, offset, len))
+			return -1;
+
+		for (i = 0; i < len; i += sizeof(val)) {
+			val = fast_spi_read_reg(flash, SPIBAR_FDATA(i / 4));
+			memcpy(data + i, &val, MIN(sizeof(val), len - i));
+		}
+
+		data += len;
+		offset += len;
+		size -= len;
+	}
+
+	return 0;
+}
+
+static void *fast_spi_flash_read(FlashOps *me, uint32_t offset,
+				 uint32_t size)
+{
+	FastSpiFlash *flash = container_of(me, FastSpiFlash, ops);
+
+	if (offset > flash->rom_size || size > flash->rom_size - offset) {
+		printf("%s: Out of bounds flash access.\n", __func__);
+		return NULL;
+	}
+
+	/*
+	 * Reads of the BIOS region come straight from its mapped window until
+	 * something goes through hardware sequencing. From then on they are
+	 * copied into the cache so that every pointer FlashCache hands out
+	 * points into it.
+	 */
+	if (!flash->mmap_stale && offset >= flash->bios_base &&
+	    offset - flash->bios_base + size <= flash->bios_size) {
+		void *window = (void *)(flash->bios_mmap + offset -
+					flash->bios_base);
+
+		if (!flash->cache)
+			return window;
+		memcpy(flash->cache + offset, window, size);
+		return flash->cache + offset;
+	}
+
+	/*
+	 * Hardware sequencing is only needed outside the BIOS region or after
+	 * the flash was modified, so the buffer for it isn't allocated before
+	 * then. It mirrors the whole part, which may not fit in the heap.
+	 */
+	if (!flash->cache) {
+		flash->cache = malloc(flash->rom_size);
+		if (!flash->cache) {
+			printf("%s: No memory for a %#x byte read buffer.\n",
+			       __func__, flash->rom_size);
+			return NULL;
+		}
+		me->cache = new_flash_cache(flash->cache, flash->rom_size);
+	}
+
+	if (fast_spi_hwseq_read(flash, flash->cache + offset, offset, size))
+		return NULL;
+
+	return flash->cache + offset;
+}
+
+static int fast_spi_flash_write(FlashOps *me, const void *buffer,
+				uint32_t offset, uint32_t size)
+{
+	FastSpiFlash *flash = container_of(me, FastSpiFlash, ops);
+	const uint8_t *data = buffer;
+	uint32_t written = 0;
+
+	if (offset > flash->rom_size || size > flash->rom_size - offset)
+		return -1;
+
+	/*
+	 * The mapped window may be cached by the CPU and is not guaranteed to
+	 * reflect writes, so stop using it from here on.
+	 */
+	flash->mmap_stale = 1;
+
+	while (size) {
+		uint32_t len = MIN(size, HWSEQ_FIFO_SIZE);
+		uint32_t i, val;
+
+		len = MIN(len, HWSEQ_PAGE_SIZE - offset % HWSEQ_PAGE_SIZE);
+
+		for (i = 0; i < len; i += sizeof(val)) {
+			val = 0xffffffff;
+			memcpy(&val, data + i, MIN(sizeof(val), len - i));
+			fast_spi_write_reg(flash, SPIBAR_FDATA(i / 4), val);
+		}
+
+		if (fast_spi_cycle(flash, HWSEQ_WRITE, offset, len))
+			break;
+
+		data += len;
+		offset += len;
+		size -= len;
+		written += len;
+	}
+
+	return written;
+}
+
+static int fast_spi_flash_erase(FlashOps *me, uint32_t start, uint32_t size)
+{
+	FastSpiFlash *flash = container_of(me, FastSpiFlash, ops);
+	uint32_t offset = 0;
+
+	if ((start % me->sector_size) || (size % me->sector_size)) {
+		printf("%s: Erase not %u aligned, start=%u size=%u\n",
+		       __func__, me->sector_size, start, size);
+		return -1;
+	}
+
+	if (start > flash->rom_size || size > flash->rom_size - start)
+		return -1;
+
+	flash->mmap_stale = 1;
+
+	while (offset < size) {
+		uint32_t addr = start + offset;
+
+		/* Use 64KiB erases where alignment allows. */
+		if (!(addr % (64 * KiB)) && (size - offset) >= 64 * KiB) {
+			if (fast_spi_cycle(flash, HWSEQ_ERASE_64K, addr, 1))
+				break;
+			offset += 64 * KiB;
+		} else {
+			if (fast_spi_cycle(flash, HWSEQ_ERASE_4K, addr, 1))
+				break;
+			offset += 4 * KiB;
+		}
+	}
+
+	return offset;
+}
+
+FastSpiFlash *new_fast_spi_flash(pcidev_t dev)
+{
+	FastSpiFlash *flash = xzalloc(sizeof(*flash));
+	uint32_t bfpreg, bios_end;
+
+	flash->mmio_base = pci_read_config32(dev, PCI_BASE_ADDRESS_0) &
+		PCI_BASE_ADDRESS_MEM_MASK;
+
+	bfpreg = fast_spi_read_reg(flash, SPIBAR_BFPREG);
+	flash->bios_base = (bfpreg & BFPREG_BASE_MASK) * 4 * KiB;
+	bios_end = (((bfpreg & BFPREG_LIMIT_MASK) >> BFPREG_LIMIT_SHIFT) + 1) *
+		4 * KiB;
+	flash->bios_size = bios_end - flash->bios_base;
+	flash->bios_mmap = 4ULL * GiB - flash->bios_size;
+
+	flash->rom_size = lib_sysinfo.spi_flash.size;
+	if (!flash->rom_size)
+		flash->rom_size = bios_end;
+
+	flash->ops.read = &fast_spi_flash_read;
+	flash->ops.write = &fast_spi_flash_write;
+	flash->ops.erase = &fast_spi_flash_erase;
+	/* Hardware sequencing always offers 4KiB erases. */
+	flash->ops.sector_size = 4 * KiB;
+	flash->ops.sector_count = flash->rom_size / flash->ops.sector_size;
+
+	printf("Fast SPI: BIOS region %#x-%#x mapped at %#lx\n",
+	       flash->bios_base, bios_end, (unsigned long)flash->bios_mmap);
+
+	return flash;
+}
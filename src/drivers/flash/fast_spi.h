@@ -0,0 +1,51 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __DRIVERS_FLASH_FAST_SPI_H__
+#define __DRIVERS_FLASH_FAST_SPI_H__
+
+#include <pci.h>
+#include <stdint.h>
+
+#include "drivers/flash/flash.h"
+
+/*
+ * Flash behind the Intel fast SPI controller (Skylake and later), accessed
+ * with hardware sequencing. Reads from the BIOS region use its memory mapped
+ * window instead.
+ */
+typedef struct FastSpiFlash
+{
+	FlashOps ops;
+	uintptr_t mmio_base;
+	uint32_t rom_size;
+
+	/* BIOS region, memory mapped directly below 4GiB */
+	uint32_t bios_base;
+	uint32_t bios_size;
+	uintptr_t bios_mmap;
+	/* Set once the flash has been modified behind the mapped window */
+	int mmap_stale;
+
+	/* Read buffer, allocated and tracked by ops.cache on first use */
+	uint8_t *cache;
+} FastSpiFlash;
+
+/* dev is the SPI controller, i.e. PCI_DEV(0, 0x1f, 5) or PCI_DEV(0, 0xd, 2) */
+FastSpiFlash *new_fast_spi_flash(pcidev_t dev);
+
+#endif /* __DRIVERS_FLASH_FAST_SPI_H__ */
@@ -19,16 +19,108 @@
 
 #include "drivers/flash/flash.h"
 
+FlashCache *new_flash_cache(uint8_t *data, uint32_t size)
+{
+	FlashCache *cache = xzalloc(sizeof(*cache));
+	uint32_t blocks = ALIGN_UP(size, FLASH_CACHE_BLOCK_SIZE) /
+		FLASH_CACHE_BLOCK_SIZE;
+
+	cache->data = data;
+	cache->size = size;
+	cache->valid = xzalloc(ALIGN_UP(blocks, 32) / 8);
+	return cache;
+}
+
+static int flash_cache_valid(FlashCache *cache, uint32_t block)
+{
+	return cache->valid[block / 32] & (1U << (block % 32));
+}
+
+static void flash_cache_set(FlashCache *cache, uint32_t first, uint32_t last,
+			    int valid)
+{
+	uint32_t block;
+
+	for (block = first; block <= last; block++) {
+		if (valid)
+			cache->valid[block / 32] |= 1U << (block % 32);
+		else
+			cache->valid[block / 32] &= ~(1U << (block % 32));
+	}
+}
+
+/* Forget cached contents of any block overlapping the given range. */
+static void flash_cache_invalidate(FlashCache *cache, uint32_t offset,
+				   uint32_t size)
+{
+	if (!cache || size == 0 || offset >= cache->size)
+		return;
+
+	size = MIN(size, cache->size - offset);
+	flash_cache_set(cache, offset / FLASH_CACHE_BLOCK_SIZE,
+			(offset + size - 1) / FLASH_CACHE_BLOCK_SIZE, 0);
+}
+
+static ListNode flash_write_listeners;
+
+void flash_add_write_listener(FlashWriteListener *listener)
+{
+	list_insert_after(&listener->list_node, &flash_write_listeners);
+}
+
+static void flash_notify_write(FlashOps *ops, uint32_t offset, uint32_t size)
+{
+	FlashWriteListener *listener;
+
+	flash_cache_invalidate(ops->cache, offset, size);
+	list_for_each(listener, flash_write_listeners, list_node)
+		listener->notify(listener, offset, size);
+}
+
 void *flash_read_ops(FlashOps *ops, uint32_t offset, uint32_t size)
 {
+	FlashCache *cache;
+	uint32_t first, last, start, end;
+
 	die_if(!ops, "%s: No flash ops set.\n", __func__);
-	return ops->read(ops, offset, size);
+
+	cache = ops->cache;
+	if (!cache || size == 0 || offset > cache->size ||
+	    size > cache->size - offset)
+		return ops->read(ops, offset, size);
+
+	/* Only the blocks between the first and last invalid one are read. */
+	first = offset / FLASH_CACHE_BLOCK_SIZE;
+	last = (offset + size - 1) / FLASH_CACHE_BLOCK_SIZE;
+	while (first <= last && flash_cache_valid(cache, first))
+		first++;
+
+	if (first > last) {
+		cache->hits++;
+		return cache->data + offset;
+	}
+
+	while (flash_cache_valid(cache, last))
+		last--;
+
+	start = first * FLASH_CACHE_BLOCK_SIZE;
+	end = MIN((last + 1) * FLASH_CACHE_BLOCK_SIZE, cache->size);
+
+	cache->misses++;
+	cache->bytes_read += end - start;
+
+	if (!ops->read(ops, start, end - start))
+		return NULL;
+
+	flash_cache_set(cache, first, last, 1);
+	return cache->data + offset;
 }
 
 int flash_write_ops(FlashOps *ops, uint32_t offset, uint32_t size,
 		    const void *buffer)
 {
 	die_if(!ops, "%s: No flash ops set.\n", __func__);
+	flash_notify_write(ops, offset, size);
 	if (ops->write)
 		return ops->write(ops, buffer, offset, size);
 
@@ -38,6 +130,7 @@ int flash_write_ops(FlashOps *ops, uint32_t offset, uint32_t size,
 int flash_erase_ops(FlashOps *ops, uint32_t offset, uint32_t size)
 {
 	die_if(!ops, "%s: No flash ops set.\n", __func__);
+	flash_notify_write(ops, offset, size);
 	if (ops->erase)
 		return ops->erase(ops, offset, size);
 
@@ -76,6 +169,87 @@ static inline uint32_t flash_sector_size_ops(FlashOps *ops)
 	return ops->sector_size;
 }
 
+/* Flash is programmed in pages of this size, erased in sectors. */
+#define FLASH_PAGE_SIZE		256
+
+/* Does changing cur into new require an erase, i.e. setting any bits? */
+static int flash_needs_erase(const uint8_t *cur, const uint8_t *new,
+			     uint32_t size)
+{
+	uint32_t i;
+
+	for (i = 0; i < size; i++)
+		if (~cur[i] & new[i])
+			return 1;
+
+	return 0;
+}
+
+static int flash_is_erased(const uint8_t *data, uint32_t size)
+{
+	uint32_t i;
+
+	for (i = 0; i < size; i++)
+		if (data[i] != 0xff)
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Program the pages of data that differ from cur, which is the current
+ * content of the flash at offset. Pass cur == NULL after an erase.
+ */
+static int flash_program_pages(FlashOps *ops, uint32_t offset,
+			       const uint8_t *cur, const uint8_t *data,
+			       uint32_t size)
+{
+	uint32_t done, len;
+
+	for (done = 0; done < size; done += len) {
+		len = MIN(FLASH_PAGE_SIZE, size - done);
+
+		if (cur ? !memcmp(cur + done, data + done, len) :
+		    flash_is_erased(data + done, len))
+			continue;
+
+		if (flash_write_ops(ops, offset + done, len,
+				    data + done) != len)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Erase a run of sectors with one request and program their new content. */
+static int flash_rewrite_run(FlashOps *ops, uint32_t offset,
+			     const uint8_t *data, uint32_t size)
+{
+	int ret;
+
+	if (size == 0)
+		return 0;
+
+	ret = flash_erase_ops(ops, offset, size);
+	if (ret != size) {
+		printf("rewriting failed in erase ret=%d\n", ret);
+		return -1;
+	}
+
+	if (flash_program_pages(ops, offset, NULL, data, size)) {
+		printf("rewriting failed in write\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Only sectors whose content changes are touched. If no bit has to go from
+ * 0 to 1, the changed pages are programmed without erasing. Consecutive
+ * sectors that do need an erase are erased with a single request, so that
+ * the driver can use larger block erases.
+ */
 int flash_rewrite_ops(FlashOps *ops, uint32_t start, uint32_t length,
 		      const void *buffer)
 {
@@ -83,25 +257,56 @@ int flash_rewrite_ops(FlashOps *ops, uint32_t start, uint32_t length,
 	uint32_t initial_start = ALIGN_DOWN(start, sector_size);
 	uint32_t final_end = ALIGN_UP(start + length, sector_size);
 	uint32_t full_length = final_end - initial_start;
-	if (initial_start != start || final_end != full_length) {
-		char *dev_buffer = flash_read_ops(ops, initial_start,
-						  full_length);
-		memcpy(dev_buffer + (start - initial_start), buffer, length);
-		buffer = dev_buffer;
-	}
-	int ret = flash_erase_ops(ops, initial_start, full_length);
-	if (ret != full_length) {
-		printf("rewriting SPI GPT failed in erase ret=%d\n", ret);
-		return ret;
+	uint32_t run_start = initial_start, run_size = 0;
+	uint8_t *merged = NULL;
+	const uint8_t *data = buffer;
+	const uint8_t *cur, *new;
+	uint32_t offset;
+	int ret = -1;
+
+	if (initial_start != start || final_end != start + length) {
+		cur = flash_read_ops(ops, initial_start, full_length);
+		if (!cur)
+			return -1;
+		merged = xmalloc(full_length);
+		memcpy(merged, cur, full_length);
+		memcpy(merged + (start - initial_start), buffer, length);
+		data = merged;
 	}
-	ret = flash_write_ops(ops, initial_start, full_length, buffer);
-	if (ret != full_length) {
-		printf("rewriting failed in write ret=%d\n", ret);
-		/* Can't return ret directly because it might equal length
-		 * and be interpreted as success. */
-		return ret == length ? -1 : ret;
+
+	for (offset = initial_start; offset < final_end;
+	     offset += sector_size) {
+		new = data + (offset - initial_start);
+		cur = flash_read_ops(ops, offset, sector_size);
+
+		if (cur && !flash_needs_erase(cur, new, sector_size)) {
+			if (flash_rewrite_run(ops, run_start,
+					      data + (run_start - initial_start),
+					      run_size))
+				goto out;
+			run_size = 0;
+
+			if (flash_program_pages(ops, offset, cur, new,
+						sector_size)) {
+				printf("rewriting failed in write\n");
+				goto out;
+			}
+			continue;
+		}
+
+		if (run_size == 0)
+			run_start = offset;
+		run_size += sector_size;
 	}
-	return length;
+
+	if (flash_rewrite_run(ops, run_start, data + (run_start - initial_start),
+			      run_size))
+		goto out;
+
+	ret = length;
+out:
+	free(merged);
+	return ret;
 }
 
 static FlashOps *flash_ops;
@@ -151,3 +356,8 @@ int flash_is_wp_enabled(void)
 {
 	return flash_is_wp_enabled_ops(flash_ops);
 }
+
+FlashCache *flash_get_cache(void)
+{
+	return flash_ops ? flash_ops->cache : NULL;
+}
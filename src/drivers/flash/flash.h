@@ -20,6 +20,39 @@
 
 #include <stdint.h>
 
+#include "base/list.h"
+
+/*
+ * Tracks which parts of a driver's read cache hold valid flash contents, so
+ * that repeated reads of the same range are served without bus traffic.
+ */
+typedef struct FlashCache
+{
+	/* Driver read buffer, mirroring the flash from offset 0. */
+	uint8_t *data;
+	uint32_t size;
+	/* One bit per FLASH_CACHE_BLOCK_SIZE bytes of data. */
+	uint32_t *valid;
+	/* Statistics */
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t bytes_read;
+} FlashCache;
+
+#define FLASH_CACHE_BLOCK_SIZE	256
+
+FlashCache *new_flash_cache(uint8_t *data, uint32_t size);
+
+/* Notified before any write or erase of the given flash range. */
+typedef struct FlashWriteListener
+{
+	void (*notify)(struct FlashWriteListener *me, uint32_t offset,
+		       uint32_t size);
+	ListNode list_node;
+} FlashWriteListener;
+
+void flash_add_write_listener(FlashWriteListener *listener);
+
 typedef struct FlashOps
 {
 	/* Return a pointer to the read data in the flash driver cache. */
@@ -39,6 +72,8 @@ typedef struct FlashOps
 	uint32_t sector_size;
 	/* Total number of sectors present */
 	uint32_t sector_count;
+	/* Optional, set if read() returns pointers into a cache buffer. */
+	FlashCache *cache;
 } FlashOps;
 
 /* Functions operating on flash_ops */
@@ -51,6 +86,7 @@ int flash_rewrite(uint32_t start, uint32_t length, const void *buffer);
 int flash_write_status(uint8_t status);
 int flash_read_status(void);
 int flash_is_wp_enabled(void);
+FlashCache *flash_get_cache(void);
 
 /* Functions operating on passed in ops */
 void *flash_read_ops(FlashOps *ops, uint32_t offset, uint32_t size);
@@ -94,6 +94,7 @@ IchFlash *new_ich9_spi_flash(uint32_t rom_size)
 	flash->get_lock = &ich9_spi_get_lock;
 
 	flash->rom_size = rom_size;
+	flash->ops.cache = new_flash_cache(flash->cache, rom_size);
 
 	return flash;
 }
@@ -20,6 +20,7 @@
 #include <endian.h>
 #include <libpayload.h>
 
+#include "base/cleanup_funcs.h"
 #include "base/container_of.h"
 #include "drivers/bus/spi/spi.h"
 #include "drivers/flash/spi.h"
@@ -30,30 +31,326 @@ typedef enum {
 	WriteStatus = 1,
 	WriteCommand = 2,
 	WriteEnableCommand = 6,
-	ReadId = 0x9f
+	FastReadCommand = 0x0b,
+	DualOutputReadCommand = 0x3b,
+	QuadOutputReadCommand = 0x6b,
+	ReadSfdp = 0x5a,
+	ReadId = 0x9f,
+	Enter4ByteAddress = 0xb7,
+	Exit4ByteAddress = 0xe9
 } SpiFlashCommands;
 
+/* Serial Flash Discoverable Parameters (JESD216) */
+#define SFDP_SIGNATURE		0x50444653	/* "SFDP" */
+#define SFDP_BFPT_ID		0xff00
+#define SFDP_DUMMY_BYTES	1
+
+typedef struct __attribute__((packed)) {
+	uint32_t signature;
+	uint8_t minor;
+	uint8_t major;
+	/* Number of parameter headers, 0's based */
+	uint8_t nph;
+	uint8_t reserved;
+} SfdpHeader;
+
+typedef struct __attribute__((packed)) {
+	uint8_t id_lsb;
+	uint8_t minor;
+	uint8_t major;
+	/* Length of the table in dwords */
+	uint8_t length;
+	uint8_t table_ptr[3];
+	uint8_t id_msb;
+} SfdpParamHeader;
+
+/* Basic Flash Parameter Table, dword 1 */
+#define BFPT_DW1_FAST_READ_112	(1 << 16)
+#define BFPT_DW1_ADDR_BYTES(x)	(((x) >> 17) & 0x3)
+#define  BFPT_ADDR_3		0
+#define  BFPT_ADDR_3_OR_4	1
+#define  BFPT_ADDR_4		2
+#define BFPT_DW1_FAST_READ_114	(1 << 22)
+/* Dword 3 (1-1-4) and 4 (1-1-2) each describe a fast read mode as:
+ * bits 4:0 dummy clocks, 7:5 mode clocks, 15:8 opcode. */
+#define BFPT_DW3_FAST_READ_114(x)	((x) >> 16)
+#define BFPT_DW4_FAST_READ_112(x)	((x) & 0xffff)
+#define BFPT_READ_CLOCKS(x)	(((x) & 0x1f) + (((x) >> 5) & 0x7))
+#define BFPT_READ_OPCODE(x)	(((x) >> 8) & 0xff)
+/* Dwords 8 and 9 each describe two erase types as:
+ * bits 7:0 size as a power of two, 15:8 opcode. */
+#define BFPT_ERASE_TYPE(dw, n)	(((dw) >> ((n) * 16)) & 0xffff)
+#define BFPT_ERASE_SIZE(x)	((x) & 0xff)
+#define BFPT_ERASE_OPCODE(x)	(((x) >> 8) & 0xff)
+/* Dword 16 (JESD216A and later), ways to get to 4-byte addressing */
+#define BFPT_DW16_EN4B		(1 << 24)	/* issue B7h */
+#define BFPT_DW16_WREN_EN4B	(1 << 25)	/* issue 06h, then B7h */
+#define BFPT_DW16_4B_OPCODES	(1 << 29)	/* dedicated instruction set */
+
+/* 3-byte addressing reaches 16MiB, beyond that 4-byte addresses are needed. */
+#define SPI_FLASH_3B_LIMIT	(16 * MiB)
+
+static uint8_t spi_flash_opcode_4b(uint8_t opcode)
+{
+	switch (opcode) {
+	case ReadCommand:		return 0x13;
+	case FastReadCommand:		return 0x0c;
+	case DualOutputReadCommand:	return 0x3c;
+	case QuadOutputReadCommand:	return 0x6c;
+	case WriteCommand:		return 0x12;
+	case 0x20:			return 0x21;	/* 4KiB erase */
+	case 0x52:			return 0x5c;	/* 32KiB erase */
+	case 0xd8:			return 0xdc;	/* 64KiB erase */
+	default:			return opcode;
+	}
+}
+
+/*
+ * Build a command with its address in cmd. Returns the number of bytes
+ * used, which is 1 + the address width.
+ */
+static int spi_flash_command(SpiFlash *flash, uint8_t *cmd, uint8_t opcode,
+			     uint32_t offset)
+{
+	int i;
+
+	if (flash->opcodes_4b)
+		opcode = spi_flash_opcode_4b(opcode);
+
+	cmd[0] = opcode;
+	for (i = flash->addr_bytes; i > 0; i--) {
+		cmd[i] = offset & 0xff;
+		offset >>= 8;
+	}
+
+	return flash->addr_bytes + 1;
+}
+
+static int spi_flash_read_sfdp(SpiFlash *flash, uint32_t offset, void *data,
+			       uint32_t size)
+{
+	uint8_t cmd[4 + SFDP_DUMMY_BYTES] = {
+		ReadSfdp, offset >> 16, offset >> 8, offset,
+	};
+	int ret = 0;
+
+	if (flash->spi->start(flash->spi))
+		return -1;
+
+	if (flash->spi->transfer(flash->spi, NULL, cmd, sizeof(cmd)) ||
+	    flash->spi->transfer(flash->spi, data, NULL, size))
+		ret = -1;
+
+	if (flash->spi->stop(flash->spi))
+		ret = -1;
+
+	return ret;
+}
+
+/* Send a command which has neither address nor data. */
+static int spi_flash_simple_command(SpiFlash *flash, uint8_t opcode)
+{
+	int ret = 0;
+
+	if (flash->spi->start(flash->spi))
+		return -1;
+
+	if (flash->spi->transfer(flash->spi, NULL, &opcode, 1))
+		ret = -1;
+
+	if (flash->spi->stop(flash->spi))
+		ret = -1;
+
+	return ret;
+}
+
+static int spi_flash_enter_exit_4b(SpiFlash *flash, uint8_t opcode)
+{
+	if (flash->wren_4b &&
+	    spi_flash_simple_command(flash, WriteEnableCommand))
+		return -1;
+
+	return spi_flash_simple_command(flash, opcode);
+}
+
+/*
+ * Leave the part in 3-byte address mode again, whatever runs next may not
+ * expect it to be in 4-byte mode.
+ */
+static int spi_flash_exit_4b(struct CleanupFunc *cleanup, CleanupType type)
+{
+	SpiFlash *flash = cleanup->data;
+
+	if (spi_flash_enter_exit_4b(flash, Exit4ByteAddress)) {
+		printf("%s: Failed to exit 4-byte address mode.\n", __func__);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Get to the whole of a part larger than 16MiB, using the dedicated 4-byte
+ * address opcodes if the part has them, otherwise entering 4-byte mode.
+ */
+static void spi_flash_setup_4b(SpiFlash *flash, uint32_t dw16)
+{
+	if (dw16 & BFPT_DW16_4B_OPCODES) {
+		flash->addr_bytes = 4;
+		flash->opcodes_4b = 1;
+		return;
+	}
+
+	if (!(dw16 & (BFPT_DW16_EN4B | BFPT_DW16_WREN_EN4B))) {
+		printf("%s: No supported way to address beyond %dMiB.\n",
+		       __func__, SPI_FLASH_3B_LIMIT / MiB);
+		return;
+	}
+
+	flash->wren_4b = !(dw16 & BFPT_DW16_EN4B);
+	if (spi_flash_enter_exit_4b(flash, Enter4ByteAddress)) {
+		printf("%s: Failed to enter 4-byte address mode.\n", __func__);
+		return;
+	}
+	flash->addr_bytes = 4;
+
+	CleanupFunc *cleanup = xzalloc(sizeof(*cleanup));
+	cleanup->cleanup = &spi_flash_exit_4b;
+	cleanup->types = CleanupOnReboot | CleanupOnPowerOff |
+			 CleanupOnHandoff | CleanupOnLegacy;
+	cleanup->data = flash;
+	list_insert_after(&cleanup->list_node, &cleanup_funcs);
+}
+
+/* Pick a read mode supported by both the flash and the controller. */
+static void spi_flash_use_read_mode(SpiFlash *flash, uint32_t desc,
+				    uint8_t lines)
+{
+	uint8_t clocks = BFPT_READ_CLOCKS(desc);
+
+	/* Dummy clocks are sent as bytes on a single line. */
+	if (clocks % 8)
+		return;
+
+	flash->read_cmd = BFPT_READ_OPCODE(desc);
+	flash->read_dummy_bytes = clocks / 8;
+	flash->read_lines = lines;
+}
+
+/*
+ * Set up addressing and the read command. Parts without SFDP keep using the
+ * plain read command, which every SPI NOR flash understands.
+ */
+static void spi_flash_probe(SpiFlash *flash)
+{
+	SfdpHeader hdr;
+	SfdpParamHeader param;
+	uint32_t bfpt[16] = { 0 };
+	uint32_t table;
+	int dwords;
+	int i, j, n;
+
+	flash->probed = 1;
+	flash->addr_bytes = 3;
+	flash->read_cmd = ReadCommand;
+	flash->read_dummy_bytes = 0;
+	flash->read_lines = 1;
+
+	if (spi_flash_read_sfdp(flash, 0, &hdr, sizeof(hdr)) ||
+	    le32toh(hdr.signature) != SFDP_SIGNATURE)
+		return;
+
+	/* The first parameter header always describes the basic table. */
+	if (spi_flash_read_sfdp(flash, sizeof(hdr), &param, sizeof(param)) ||
+	    ((param.id_msb << 8) | param.id_lsb) != SFDP_BFPT_ID ||
+	    param.length < 9)
+		return;
+
+	/* JESD216 parts only have the first 9 dwords, zero the rest. */
+	dwords = MIN(param.length, ARRAY_SIZE(bfpt));
+	table = param.table_ptr[0] | (param.table_ptr[1] << 8) |
+		(param.table_ptr[2] << 16);
+	if (spi_flash_read_sfdp(flash, table, bfpt, dwords * sizeof(bfpt[0])))
+		return;
+
+	for (i = 0; i < dwords; i++)
+		bfpt[i] = le32toh(bfpt[i]);
+
+	/* 4-byte only parts take 4-byte addresses with the usual opcodes. */
+	if (BFPT_DW1_ADDR_BYTES(bfpt[0]) == BFPT_ADDR_4)
+		flash->addr_bytes = 4;
+	else if (BFPT_DW1_ADDR_BYTES(bfpt[0]) == BFPT_ADDR_3_OR_4 &&
+		 flash->rom_size > SPI_FLASH_3B_LIMIT)
+		spi_flash_setup_4b(flash, bfpt[15]);
+
+	/* Every SFDP capable part supports Fast Read with 8 dummy clocks. */
+	flash->read_cmd = FastReadCommand;
+	flash->read_dummy_bytes = 1;
+
+	if (flash->spi->transfer_rx &&
+	    (flash->spi->rx_lines & SPI_RX_QUAD) &&
+	    (bfpt[0] & BFPT_DW1_FAST_READ_114))
+		spi_flash_use_read_mode(flash,
+					BFPT_DW3_FAST_READ_114(bfpt[2]), 4);
+	else if (flash->spi->transfer_rx &&
+		 (flash->spi->rx_lines & SPI_RX_DUAL) &&
+		 (bfpt[0] & BFPT_DW1_FAST_READ_112))
+		spi_flash_use_read_mode(flash,
+					BFPT_DW4_FAST_READ_112(bfpt[3]), 2);
+
+	/* Record the erase types, sorted by size, largest first. */
+	for (i = n = 0; i < ARRAY_SIZE(flash->erase_size); i++) {
+		uint32_t type = BFPT_ERASE_TYPE(bfpt[7 + i / 2], i % 2);
+		uint32_t size;
+
+		if (!BFPT_ERASE_SIZE(type) || BFPT_ERASE_SIZE(type) >= 32)
+			continue;
+		size = 1U << BFPT_ERASE_SIZE(type);
+
+		for (j = n++; j > 0 && flash->erase_size[j - 1] < size; j--) {
+			flash->erase_size[j] = flash->erase_size[j - 1];
+			flash->erase_opcode[j] = flash->erase_opcode[j - 1];
+		}
+		flash->erase_size[j] = size;
+		flash->erase_opcode[j] = BFPT_ERASE_OPCODE(type);
+	}
+}
+
 static void *spi_flash_read(FlashOps *me, uint32_t offset, uint32_t size)
 {
 	SpiFlash *flash = container_of(me, SpiFlash, ops);
 	uint8_t *data = flash->cache + offset;
+	uint8_t command[5 + 4];
+	int command_size;
+	int ret;
 
 	assert(offset + size <= flash->rom_size);
 
+	if (!flash->probed)
+		spi_flash_probe(flash);
+
 	if (flash->spi->start(flash->spi)) {
 		printf("%s: Failed to start flash transaction.\n", __func__);
 		return NULL;
 	}
 
-	uint32_t command = swap_bytes32((ReadCommand << 24) | offset);
+	command_size = spi_flash_command(flash, command, flash->read_cmd,
+					 offset);
+	memset(command + command_size, 0, flash->read_dummy_bytes);
+	command_size += flash->read_dummy_bytes;
 
-	if (flash->spi->transfer(flash->spi, NULL, &command, sizeof(command))) {
+	if (flash->spi->transfer(flash->spi, NULL, command, command_size)) {
 		printf("%s: Failed to send read command.\n", __func__);
 		flash->spi->stop(flash->spi);
 		return NULL;
 	}
 
-	if (flash->spi->transfer(flash->spi, data, NULL, size)) {
+	if (flash->read_lines > 1)
+		ret = flash->spi->transfer_rx(flash->spi, data, size,
+					      flash->read_lines);
+	else
+		ret = flash->spi->transfer(flash->spi, data, NULL, size);
+
+	if (ret) {
 		printf("%s: Failed to receive %u bytes.\n", __func__, size);
 		flash->spi->stop(flash->spi);
 		return NULL;
@@ -85,10 +382,11 @@ static int toggle_cs(SpiFlash *flash, const char *phase)
 	return 0;
 }
 
-/* Allow up to 2s for a transaction to complete
- * This value is used for both write and erase */
+/* Allow up to 4s for a transaction to complete
+ * This value is used for both write and erase, 64KiB block erases
+ * take up to 2s on common parts */
 #define POLL_INTERVAL_US 10
-#define MAX_POLL_CYCLES (2000000/POLL_INTERVAL_US)
+#define MAX_POLL_CYCLES (4000000/POLL_INTERVAL_US)
 #define SPI_FLASH_STATUS_WIP (1 << 0)
 #define SPANSION_FLASH_ERASE_ERR (1 << 5)
 #define SPANSION_FLASH_PROG_ERR (1 << 6)
@@ -201,14 +499,15 @@ static int spi_flash_modify(SpiFlash *flash, const void *buffer,
 			    uint32_t offset, uint32_t size, uint8_t opcode,
 			    const char *opname)
 {
-	union {
-		uint8_t bytes[4]; // We're using 3 byte addresses.
-		uint32_t whole;
-	} command;
+	uint8_t command[5];
+	int command_size;
 
 	int stop_needed = 0;
 	uint32_t rv = -1;
 
+	if (!flash->probed)
+		spi_flash_probe(flash);
+
 	do {
 		/* Each write or erase command requires a 'write enable' (WREN)
 		 * first. */
@@ -218,8 +517,8 @@ static int spi_flash_modify(SpiFlash *flash, const void *buffer,
 			break;
 		}
 
-		command.bytes[0] = WriteEnableCommand;
-		if (flash->spi->transfer(flash->spi, NULL, &command, 1)) {
+		command[0] = WriteEnableCommand;
+		if (flash->spi->transfer(flash->spi, NULL, command, 1)) {
 			printf("%s: Failed to send write enable command.\n",
 			       __func__);
 			stop_needed = 1;
@@ -234,8 +533,10 @@ static int spi_flash_modify(SpiFlash *flash, const void *buffer,
 			break;
 
 		stop_needed = 1;
-		command.whole = swap_bytes32((opcode << 24) | offset);
-		if (flash->spi->transfer(flash->spi, NULL, &command, 4)) {
+		command_size = spi_flash_command(flash, command, opcode,
+						 offset);
+		if (flash->spi->transfer(flash->spi, NULL, command,
+					 command_size)) {
 			printf("%s: Failed to send %s command.\n",
 			       __func__, opname);
 			break;
@@ -303,11 +604,32 @@ static int spi_flash_erase(FlashOps *me, uint32_t start, uint32_t size)
 		return -1;
 	}
 	assert(start + size <= flash->rom_size);
-	int offset;
-	for (offset = 0; offset < size; offset += sector_size) {
-		if (spi_flash_modify(flash, NULL, start + offset, 0,
-				     flash->erase_cmd, "erase"))
+
+	if (!flash->probed)
+		spi_flash_probe(flash);
+
+	int offset = 0;
+	while (offset < size) {
+		uint32_t addr = start + offset;
+		uint32_t erase_size = sector_size;
+		uint8_t opcode = flash->erase_cmd;
+		int i;
+
+		/* Use the largest block erase that fits the remaining range. */
+		for (i = 0; i < ARRAY_SIZE(flash->erase_size); i++) {
+			uint32_t block = flash->erase_size[i];
+
+			if (block > sector_size && !(addr % block) &&
+			    size - offset >= block) {
+				erase_size = block;
+				opcode = flash->erase_opcode[i];
+				break;
+			}
+		}
+
+		if (spi_flash_modify(flash, NULL, addr, 0, opcode, "erase"))
 			break;
+		offset += erase_size;
 	}
 	return offset;
 }
@@ -418,5 +740,6 @@ SpiFlash *new_spi_flash(SpiOps *spi)
 	/* Provide sufficient alignment on the cache buffer so that the
 	 * underlying SPI controllers can perform optimal DMA transfers. */
 	flash->cache = xmemalign(1*KiB, rom_size);
+	flash->ops.cache = new_flash_cache(flash->cache, rom_size);
 	return flash;
 }
@@ -32,6 +32,20 @@ typedef struct
 	uint32_t rom_size;
 	uint8_t erase_cmd;
 	uint8_t *cache;
+
+	/* Set up from SFDP on first access */
+	int probed;
+	uint8_t addr_bytes;
+	/* Use the dedicated 4-byte address opcodes */
+	uint8_t opcodes_4b;
+	/* Entering or leaving 4-byte address mode needs a WREN first */
+	uint8_t wren_4b;
+	uint8_t read_cmd;
+	uint8_t read_dummy_bytes;
+	uint8_t read_lines;
+	/* Erase types from SFDP, largest first, size 0 if unused */
+	uint32_t erase_size[4];
+	uint8_t erase_opcode[4];
 } SpiFlash;
 
 SpiFlash *new_spi_flash(SpiOps *spi);
@@ -37,6 +37,21 @@ typedef enum Modifier {
 	ModifierShift = 0x4
 } Modifier;
 
+/*
+ * How long to leave the EC alone after it ran out of events, if there is no
+ * interrupt line to tell us when it has new ones. Otherwise every check for
+ * input while the firmware UI is waiting turns into an EC host command.
+ */
+static const uint64_t MkbpIdlePollUs = 10 * 1000;
+
+// When the EC last ran out of events, 0 if it may have some.
+static uint64_t ec_idle_since_us;
+
+static void mkbp_ec_went_idle(void)
+{
+	ec_idle_since_us = timer_us(0);
+}
+
 /*
  * EC has no more states if:
  * 1. It no longer asserts the interrupt line or
@@ -44,6 +59,16 @@ typedef enum Modifier {
  */
 static int more_input_states(void)
 {
+	if (!IS_ENABLED(CONFIG_DRIVER_INPUT_MKBP_NO_INTERRUPT) &&
+	    cros_ec_interrupt_available())
+		return cros_ec_interrupt_pending();
+
+	if (ec_idle_since_us) {
+		if (timer_us(ec_idle_since_us) < MkbpIdlePollUs)
+			return 0;
+		ec_idle_since_us = 0;
+	}
+
 	if (IS_ENABLED(CONFIG_DRIVER_INPUT_MKBP_NO_INTERRUPT)) {
 		uint32_t events;
 		const uint32_t mkbp_mask =
@@ -55,10 +80,11 @@ static int more_input_states(void)
 			return 1;
 		}
 
+		mkbp_ec_went_idle();
 		return 0;
 	}
 
-	return cros_ec_interrupt_pending();
+	return 1;
 }
 
 typedef struct Key
@@ -354,13 +380,19 @@ static int mkbp_process_events(Modifier *modifiers, uint16_t *codes,
 	if (!more_input_states())
 		return -1;
 
-	if (mkbp_read_event(&event))
+	if (mkbp_read_event(&event)) {
+		mkbp_ec_went_idle();
 		return -1;
+	}
 
-	if (event.event_type == EC_MKBP_EVENT_KEY_MATRIX)
-		return mkbp_process_keymatrix(modifiers, codes, max_codes,
-						&event);
-	else if (event.event_type == EC_MKBP_EVENT_BUTTON)
+	if (event.event_type == EC_MKBP_EVENT_KEY_MATRIX) {
+		int total = mkbp_process_keymatrix(modifiers, codes, max_codes,
+						   &event);
+		// An unchanged matrix means the EC's FIFO was empty.
+		if (total < 0)
+			mkbp_ec_went_idle();
+		return total;
+	} else if (event.event_type == EC_MKBP_EVENT_BUTTON)
 		return mkbp_process_buttons(codes, max_codes, &event);
 
 	return 0;
@@ -22,52 +22,153 @@
 #include <stdint.h>
 
 #include "base/container_of.h"
+#include "base/list.h"
 #include "config.h"
 #include "drivers/bus/i2s/i2s.h"
 #include "drivers/sound/i2s.h"
 
-// Generates square wave sound data for 1 second.
-static void sound_square_wave(uint16_t *data, int channels,
-			      int sample_rate, uint32_t freq, uint16_t volume)
+typedef struct {
+	ListNode list_node;
+	uint32_t frequency;
+	uint32_t *data;
+	unsigned int length;	// In 32-bit words.
+} I2sWaveform;
+
+enum {
+	// Roughly how much sound each cached waveform holds. Long enough that
+	// a looping bus doesn't have to wrap around all the time, short enough
+	// to keep a few frequencies around.
+	WaveformMs = 20,
+};
+
+// Generates a square wave, a whole number of periods long.
+static void sound_square_wave(uint16_t *data, int channels, int period,
+			      int periods, uint16_t volume)
 {
-	assert(freq);
-
-	const int period = sample_rate / freq;
 	const int half = period / 2;
 
-	int samples = sample_rate;
-
-	while (samples) {
-		for (int i = 0; samples && i < half; samples--, i++) {
+	while (periods--) {
+		for (int i = 0; i < half; i++) {
 			for (int j = 0; j < channels; j++)
 				*data++ = volume;
 		}
-		for (int i = 0; samples && i < period - half; samples--, i++) {
+		for (int i = 0; i < period - half; i++) {
 			for (int j = 0; j < channels; j++)
 				*data++ = -volume;
 		}
 	}
 }
 
+static I2sWaveform *i2s_source_waveform(I2sSource *source, uint32_t frequency)
+{
+	I2sWaveform *wave;
+
+	list_for_each(wave, source->waveforms, list_node) {
+		if (wave->frequency == frequency)
+			return wave;
+	}
+
+	assert(frequency);
+
+	const int period = source->sample_rate / frequency;
+	if (period < 2) {
+		printf("%s: Can't play %uHz at a sample rate of %d.\n",
+		       __func__, frequency, source->sample_rate);
+		return NULL;
+	}
+
+	// A multiple of four periods always fills whole 32-bit words.
+	int periods = source->sample_rate * WaveformMs / 1000 / period;
+	periods = MAX(4, ALIGN_DOWN(periods, 4));
+
+	int samples = period * periods * source->channels;
+
+	wave = xzalloc(sizeof(*wave));
+	wave->frequency = frequency;
+	wave->data = xmalloc(samples * sizeof(uint16_t));
+	wave->length = samples * sizeof(uint16_t) / sizeof(uint32_t);
+	sound_square_wave((uint16_t *)wave->data, source->channels, period,
+			  periods, source->volume);
+
+	list_insert_after(&wave->list_node, &source->waveforms);
+	return wave;
+}
+
+// Returns 1 second of sound data, for buses which can't loop by themselves.
+static uint32_t *i2s_source_second(I2sSource *source, uint32_t frequency)
+{
+	const unsigned int length = source->sample_rate * source->channels *
+				    sizeof(uint16_t) / sizeof(uint32_t);
+
+	if (source->second && source->second_frequency == frequency)
+		return source->second;
+
+	I2sWaveform *wave = i2s_source_waveform(source, frequency);
+	if (!wave)
+		return NULL;
+
+	if (!source->second)
+		source->second = xmalloc(length * sizeof(uint32_t));
+
+	for (unsigned int i = 0; i < length; i += wave->length)
+		memcpy(&source->second[i], wave->data,
+		       MIN(wave->length, length - i) * sizeof(uint32_t));
+	source->second_frequency = frequency;
+
+	return source->second;
+}
+
 static void finish_delay(uint64_t start, uint32_t msec)
 {
 	uint32_t passed = timer_us(start) / 1000;
 	mdelay(msec - passed);
 }
 
+static int i2s_source_stop(SoundOps *me)
+{
+	I2sSource *source = container_of(me, I2sSource, ops);
+
+	if (!source->looping)
+		return 0;
+
+	source->looping = 0;
+	return source->i2s->stop_loop(source->i2s) ? 1 : 0;
+}
+
+static int i2s_source_start(SoundOps *me, uint32_t frequency)
+{
+	I2sSource *source = container_of(me, I2sSource, ops);
+
+	if (i2s_source_stop(me))
+		return 1;
+
+	I2sWaveform *wave = i2s_source_waveform(source, frequency);
+	if (!wave)
+		return 1;
+
+	if (source->i2s->start_loop(source->i2s, wave->data, wave->length))
+		return 1;
+
+	source->looping = 1;
+	return 0;
+}
+
 static int i2s_source_play(SoundOps *me, uint32_t msec, uint32_t frequency)
 {
 	I2sSource *source = container_of(me, I2sSource, ops);
 
-	const int channels = source->channels;
-	const int sample_rate = source->sample_rate;
+	if (source->ops.start) {
+		if (i2s_source_start(me, frequency))
+			return 1;
+		mdelay(msec);
+		return i2s_source_stop(me);
+	}
 
-	// Prepare a buffer for 1 second of sound.
-	int bytes = sample_rate * channels * sizeof(uint16_t);
-	uint32_t *data = xmalloc(bytes);
+	uint32_t *data = i2s_source_second(source, frequency);
+	if (!data)
+		return 1;
 
-	sound_square_wave((uint16_t *)data, channels, sample_rate, frequency,
-			  source->volume);
+	int bytes = source->sample_rate * source->channels * sizeof(uint16_t);
 
 	uint64_t start = timer_us(0);
 
@@ -75,7 +176,6 @@ static int i2s_source_play(SoundOps *me, uint32_t msec, uint32_t frequency)
 		if (source->i2s->send(source->i2s, data,
 				      bytes / sizeof(uint32_t))) {
 			finish_delay(start, msec);
-			free(data);
 			return 1;
 		}
 		msec -= 1000;
@@ -84,12 +184,10 @@ static int i2s_source_play(SoundOps *me, uint32_t msec, uint32_t frequency)
 		int size = (bytes * msec) / (sizeof(uint32_t) * 1000);
 		if (source->i2s->send(source->i2s, data, size)) {
 			finish_delay(start, msec);
-			free(data);
 			return 1;
 		}
 	}
 
-	free(data);
 	return 0;
 }
 
@@ -99,6 +197,11 @@ I2sSource *new_i2s_source(I2sOps *i2s, int sample_rate, int channels,
 	I2sSource *source = xzalloc(sizeof(*source));
 
 	source->ops.play = &i2s_source_play;
+	// Sound in the background needs a bus which can loop by itself.
+	if (i2s->start_loop && i2s->stop_loop) {
+		source->ops.start = &i2s_source_start;
+		source->ops.stop = &i2s_source_stop;
+	}
 
 	source->i2s = i2s;
 
@@ -11,6 +11,7 @@
 #ifndef __DRIVERS_SOUND_I2S_H__
 #define __DRIVERS_SOUND_I2S_H__
 
+#include "base/list.h"
 #include "drivers/bus/i2s/i2s.h"
 #include "drivers/sound/sound.h"
 
@@ -23,6 +24,15 @@ typedef struct
 	int sample_rate;
 	int channels;
 	uint16_t volume;
+
+	// Square waves generated so far, one per frequency.
+	ListNode waveforms;
+
+	// One second of sound for buses which can't loop by themselves.
+	uint32_t *second;
+	uint32_t second_frequency;
+
+	int looping;
 } I2sSource;
 
 // Assumes 16 bits per sample.
@@ -171,6 +171,64 @@ static ssize_t tegra_ahub_apbif_send(TxFifoOps *me, const void *buf, size_t len)
 	return written;
 }
 
+static int tegra_ahub_apbif_start_loop(TxFifoOps *me, const void *buf,
+				       size_t len)
+{
+	TegraAudioHubApbif *apbif = container_of(me, TegraAudioHubApbif, ops);
+	TegraApbDmaController *controller = apbif->dma_controller;
+
+	if (len % sizeof(uint32_t) || !len) {
+		printf("%s: Data size (%zd) must be aligned to %zd.\n",
+		       __func__, len, sizeof(uint32_t));
+		return -1;
+	}
+	if (apbif->dma) {
+		printf("%s: Already looping.\n", __func__);
+		return -1;
+	}
+
+	TegraApbDmaChannel *dma = controller->claim(controller);
+	if (!dma)
+		return -1;
+	TegraApbDmaRegs *regs = dma->regs;
+
+	dcache_clean_by_mva(buf, len);
+
+	// 32 bit APB accesses, always to the same FIFO register.
+	writel(2 << APBDMACHAN_APB_SEQ_APB_BUS_WIDTH_SHIFT |
+	       1 << APBDMACHAN_APB_SEQ_APB_ADDR_WRAP_SHIFT, &regs->apb_seq);
+	// AHB 1 word burst, no address wrapping.
+	writel(0x4 << APBDMACHAN_AHB_SEQ_AHB_BURST_SHIFT, &regs->ahb_seq);
+
+	writel((uintptr_t)buf, &regs->ahb_ptr);
+	writel((uintptr_t)&apbif->regs->channel0_txfifo, &regs->apb_ptr);
+	writel(len / sizeof(uint32_t) - 1, &regs->wcount);
+
+	// From DRAM to the FIFO as it drains. Without ONCE, the channel starts
+	// over from the beginning of the buffer each time it reaches the end.
+	writel(APBDMACHAN_CSR_DIR | APBDMACHAN_CSR_FLOW |
+	       APBDMA_SLAVE_APBIF_CH0 << APBDMACHAN_CSR_REQ_SEL_SHIFT,
+	       &regs->csr);
+
+	dma->start(dma);
+	apbif->dma = dma;
+	return 0;
+}
+
+static int tegra_ahub_apbif_stop_loop(TxFifoOps *me)
+{
+	TegraAudioHubApbif *apbif = container_of(me, TegraAudioHubApbif, ops);
+	TegraApbDmaController *controller = apbif->dma_controller;
+	TegraApbDmaChannel *dma = apbif->dma;
+
+	if (!dma)
+		return 0;
+
+	apbif->dma = NULL;
+	dma->finish(dma);
+	return controller->release(controller, dma);
+}
+
 static void tegra_ahub_apbif_set_cif(TegraAudioHubApbif *apbif, uint32_t value)
 {
 	writel(value, &apbif->regs->channel0_cif_tx0_ctrl);
@@ -251,7 +309,8 @@ TegraAudioHubXbar *new_tegra_audio_hub_xbar(uintptr_t regs)
 }
 
 TegraAudioHubApbif *new_tegra_audio_hub_apbif(uintptr_t regs,
-					      size_t capacity_in_word)
+					      size_t capacity_in_word,
+					      TegraApbDmaController *dma)
 {
 	TegraAudioHubApbif *apbif = xzalloc(sizeof(*apbif));
 	apbif->ops.send = &tegra_ahub_apbif_send;
@@ -259,6 +318,11 @@ TegraAudioHubApbif *new_tegra_audio_hub_apbif(uintptr_t regs,
 	apbif->ops.capacity = &tegra_ahub_apbif_capacity;
 	apbif->regs = (TegraApbifRegs *)regs;
 	apbif->capacity_in_word = capacity_in_word;
+	if (dma) {
+		apbif->ops.start_loop = &tegra_ahub_apbif_start_loop;
+		apbif->ops.stop_loop = &tegra_ahub_apbif_stop_loop;
+		apbif->dma_controller = dma;
+	}
 	return apbif;
 }
 
@@ -18,6 +18,7 @@
 
 #include "drivers/bus/i2s/tegra.h"
 #include "drivers/common/fifo.h"
+#include "drivers/dma/tegra_apb.h"
 #include "drivers/sound/route.h"
 
 struct TegraXbarRegs;
@@ -36,6 +37,8 @@ typedef struct TegraAudioHubApbif
 	struct TegraApbifRegs *regs;
 	uint32_t full_mask;
 	size_t capacity_in_word;  // FIFO capacity in words.
+	TegraApbDmaController *dma_controller;  // Optional, for looping.
+	TegraApbDmaChannel *dma;  // Channel feeding the FIFO while looping.
 } TegraAudioHubApbif;
 
 typedef struct TegraAudioHub
@@ -49,7 +52,8 @@ typedef struct TegraAudioHub
 
 TegraAudioHubXbar *new_tegra_audio_hub_xbar(uintptr_t regs);
 TegraAudioHubApbif *new_tegra_audio_hub_apbif(uintptr_t regs,
-					      size_t capacity_in_word);
+					      size_t capacity_in_word,
+					      TegraApbDmaController *dma);
 TegraAudioHub *new_tegra_audio_hub(TegraAudioHubXbar *xbar,
 				   TegraAudioHubApbif *apbif,
 				   TegraI2s *i2s);
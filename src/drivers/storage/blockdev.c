@@ -16,6 +16,7 @@
  */
 
 #include "drivers/storage/blockdev.h"
+#include "drivers/storage/bouncebuf.h"
 
 #include <assert.h>
 #include <libpayload.h>
@@ -84,6 +85,63 @@ StreamOps *new_simple_stream(BlockDevOps *me, lba_t start, lba_t count)
 	return &stream->stream;
 }
 
+/*
+ * Fill writes go through a pattern buffer of up to 4MiB. Using 1 lba i.e.
+ * block_size buffer results in very large fill_write time, while 4MiB was
+ * found to be as fast as much larger buffers. The buffer is kept across calls
+ * and only refilled if the pattern changes.
+ */
+#define FILL_BUFFER_MAX_BYTES	(4 * MiB)
+
+static struct {
+	uint32_t *data;
+	uint64_t bytes;
+	uint32_t pattern;
+} fill_buffer;
+
+lba_t blockdev_fill_write(BlockDevOps *me, lba_t start, lba_t count,
+			  uint32_t fill_pattern)
+{
+	BlockDev *blockdev = (BlockDev *)me;
+	uint64_t block_size = blockdev->block_size;
+	lba_t buffer_lba = MIN(FILL_BUFFER_MAX_BYTES / block_size, count);
+	uint64_t buffer_bytes = buffer_lba * block_size;
+
+	if (count == 0)
+		return 0;
+
+	if (fill_buffer.bytes < buffer_bytes) {
+		free(fill_buffer.data);
+		fill_buffer.data = xmemalign(ARCH_DMA_MINALIGN, buffer_bytes);
+		fill_buffer.bytes = buffer_bytes;
+		fill_buffer.pattern = ~fill_pattern;
+	}
+
+	if (fill_buffer.pattern != fill_pattern) {
+		uint64_t words = fill_buffer.bytes / sizeof(uint32_t);
+		uint32_t *ptr = fill_buffer.data;
+
+		for ( ; words; words--)
+			*ptr++ = fill_pattern;
+		fill_buffer.pattern = fill_pattern;
+	}
+
+	buffer_lba = fill_buffer.bytes / block_size;
+
+	lba_t todo = count;
+
+	do {
+		lba_t curr_lba = MIN(buffer_lba, todo);
+
+		if (me->write(me, start, curr_lba, fill_buffer.data) != curr_lba)
+			return 0;
+		todo -= curr_lba;
+		start += curr_lba;
+	} while (todo > 0);
+
+	return count;
+}
+
 int get_all_bdevs(blockdev_type_t type, ListNode **bdevs)
 {
 	ListNode *ctrlrs, *devs;
@@ -37,12 +37,21 @@ typedef struct BlockDevOps {
 				 lba_t count);
 } BlockDevOps;
 
+/* fill_write() with an all zeroes pattern needs no data transfer. */
+#define BLOCKDEV_CAP_FILL_ZERO		(1 << 0)
+/* fill_write() with an all ones pattern needs no data transfer. */
+#define BLOCKDEV_CAP_FILL_ONES		(1 << 1)
+/* erase() discards blocks without writing them; contents are undefined. */
+#define BLOCKDEV_CAP_DISCARD		(1 << 2)
+
 typedef struct BlockDev {
 	BlockDevOps ops;
 
 	const char *name;
 	int removable;
 	int external_gpt;
+	/* BLOCKDEV_CAP_* flags */
+	unsigned caps;
 	unsigned block_size;
 	/* If external_gpt = 0, then stream_block_count may be 0, indicating
 	 * that the block_count value applies for both read/write and streams */
@@ -76,6 +85,13 @@ extern ListNode removable_block_dev_controllers;
 
 StreamOps *new_simple_stream(BlockDevOps *me, lba_t start, lba_t count);
 
+/*
+ * Generic fill_write implementation for devices without a native fill command.
+ * It streams a pattern buffer, kept around between calls, through me->write.
+ */
+lba_t blockdev_fill_write(BlockDevOps *me, lba_t start, lba_t count,
+			  uint32_t fill_pattern);
+
 typedef enum {
 	BLOCKDEV_FIXED,
 	BLOCKDEV_REMOVABLE,
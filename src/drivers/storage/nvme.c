@@ -427,19 +427,15 @@ static NVME_STATUS nvme_fill_prp(PrpList *prp_list, uint64_t *prp, void *buffer,
 	return NVME_SUCCESS;
 }
 
-/* Sets up read operation for up to max_transfer blocks */
-static NVME_STATUS nvme_internal_read(NvmeDrive *drive, void *buffer, lba_t start, lba_t count)
+/* Returns the next free IO submission queue entry, cleared
+ * If queue is full, completes inflight commands first
+ */
+static NVME_STATUS nvme_next_io_sq(NvmeCtrlr *ctrlr, NVME_SQ **sq)
 {
-	NvmeCtrlr *ctrlr = drive->ctrlr;
-	NVME_SQ *sq;
-	int status = NVME_SUCCESS;
-
-	if (count == 0)
-		return NVME_INVALID_PARAMETER;
+	int status;
 
-	/* If queue is full, need to complete inflight commands before submitting more */
 	if ((ctrlr->sq_t_dbl[NVME_IO_QUEUE_INDEX] + 1) % ctrlr->iosq_sz == ctrlr->sqhd[NVME_IO_QUEUE_INDEX]) {
-		DEBUG(printf("nvme_internal_read: Too many outstanding commands. Completing in-flights\n");)
+		DEBUG(printf("nvme_next_io_sq: Too many outstanding commands. Completing in-flights\n");)
 		/* Submit commands to controller */
 		nvme_ring_sq_doorbell(ctrlr, NVME_IO_QUEUE_INDEX);
 		/* Complete submitted command(s) */
@@ -448,14 +444,31 @@ static NVME_STATUS nvme_internal_read(NvmeDrive *drive, void *buffer, lba_t star
 				NVME_CCQ_SIZE,
 				NVME_GENERIC_TIMEOUT);
 		if (NVME_ERROR(status)) {
-			printf("nvme_internal_read: error %d completing outstanding commands\n",status);
+			printf("nvme_next_io_sq: error %d completing outstanding commands\n",status);
 			return status;
 		}
 	}
 
-	sq  = ctrlr->sq_buffer[NVME_IO_QUEUE_INDEX] + ctrlr->sq_t_dbl[NVME_IO_QUEUE_INDEX];
+	*sq = ctrlr->sq_buffer[NVME_IO_QUEUE_INDEX] + ctrlr->sq_t_dbl[NVME_IO_QUEUE_INDEX];
 
-	memset(sq, 0, sizeof(NVME_SQ));
+	memset(*sq, 0, sizeof(NVME_SQ));
+
+	return NVME_SUCCESS;
+}
+
+/* Sets up read operation for up to max_transfer blocks */
+static NVME_STATUS nvme_internal_read(NvmeDrive *drive, void *buffer, lba_t start, lba_t count)
+{
+	NvmeCtrlr *ctrlr = drive->ctrlr;
+	NVME_SQ *sq;
+	int status = NVME_SUCCESS;
+
+	if (count == 0)
+		return NVME_INVALID_PARAMETER;
+
+	status = nvme_next_io_sq(ctrlr, &sq);
+	if (NVME_ERROR(status))
+		return status;
 
 	sq->opc = NVME_IO_READ_OPC;
 	sq->cid = ctrlr->cid[NVME_IO_QUEUE_INDEX]++;
@@ -541,25 +554,9 @@ static NVME_STATUS nvme_internal_write(NvmeDrive *drive, void *buffer, lba_t sta
 	if (count == 0)
 		return NVME_INVALID_PARAMETER;
 
-	/* If queue is full, need to complete inflight commands before submitting more */
-	if ((ctrlr->sq_t_dbl[NVME_IO_QUEUE_INDEX] + 1) % ctrlr->iosq_sz == ctrlr->sqhd[NVME_IO_QUEUE_INDEX]) {
-		DEBUG(printf("nvme_internal_write: Too many outstanding commands. Completing in-flights\n");)
-		/* Submit commands to controller */
-		nvme_ring_sq_doorbell(ctrlr, NVME_IO_QUEUE_INDEX);
-		/* Complete submitted command(s) */
-		status = nvme_complete_cmds_polled(ctrlr,
-				NVME_IO_QUEUE_INDEX,
-				NVME_CCQ_SIZE,
-				NVME_GENERIC_TIMEOUT);
-		if (NVME_ERROR(status)) {
-			printf("nvme_internal_read: error %d completing outstanding commands\n",status);
-			return status;
-		}
-	}
-
-	sq  = ctrlr->sq_buffer[NVME_IO_QUEUE_INDEX] + ctrlr->sq_t_dbl[NVME_IO_QUEUE_INDEX];
-
-	memset(sq, 0, sizeof(NVME_SQ));
+	status = nvme_next_io_sq(ctrlr, &sq);
+	if (NVME_ERROR(status))
+		return status;
 
 	sq->opc = NVME_IO_WRITE_OPC;
 	sq->cid = ctrlr->cid[NVME_IO_QUEUE_INDEX]++;
@@ -636,6 +633,135 @@ static lba_t nvme_write(BlockDevOps *me, lba_t start, lba_t count,
 	return orig_count - count;
 }
 
+/* Fill operation entrypoint
+ * Uses Write Zeroes for a zero pattern if the controller supports it,
+ * otherwise falls back to writing the pattern from memory
+ */
+static lba_t nvme_fill_write(BlockDevOps *me, lba_t start, lba_t count,
+			     uint32_t fill_pattern)
+{
+	NvmeDrive *drive = container_of(me, NvmeDrive, dev.ops);
+	NvmeCtrlr *ctrlr = drive->ctrlr;
+	lba_t orig_count = count;
+	NVME_SQ *sq;
+	int status = NVME_SUCCESS;
+	int complete;
+
+	if (fill_pattern != 0 || !(drive->dev.caps & BLOCKDEV_CAP_FILL_ZERO))
+		return blockdev_fill_write(me, start, count, fill_pattern);
+
+	while (count > 0) {
+		lba_t blocks = MIN(count, NVME_WRITE_ZEROES_MAX_BLOCKS);
+
+		status = nvme_next_io_sq(ctrlr, &sq);
+		if (NVME_ERROR(status))
+			break;
+
+		sq->opc = NVME_IO_WRITE_ZEROES_OPC;
+		sq->cid = ctrlr->cid[NVME_IO_QUEUE_INDEX]++;
+		sq->nsid = drive->namespace_id;
+		sq->cdw10 = start;
+		sq->cdw11 = (start >> 32);
+		sq->cdw12 = (blocks - 1) & 0xFFFF;
+
+		status = nvme_submit_cmd(ctrlr, NVME_IO_QUEUE_INDEX, ctrlr->iosq_sz);
+		if (NVME_ERROR(status))
+			break;
+
+		start += blocks;
+		count -= blocks;
+	}
+
+	/* Submit commands to controller */
+	nvme_ring_sq_doorbell(ctrlr, NVME_IO_QUEUE_INDEX);
+	/* Complete submitted command(s) */
+	complete = nvme_complete_cmds_polled(ctrlr,
+			NVME_IO_QUEUE_INDEX,
+			NVME_CCQ_SIZE,
+			NVME_GENERIC_TIMEOUT);
+	if (!NVME_ERROR(status))
+		status = complete;
+
+	if (NVME_ERROR(status)) {
+		printf("nvme_fill_write: error %d\n",status);
+		return -1;
+	}
+
+	return orig_count - count;
+}
+
+/* Erase operation entrypoint
+ * Deallocates blocks with Dataset Management, up to NVME_DSM_MAX_RANGES
+ * ranges per command. Only used if DLFEAT says what the blocks read back as.
+ */
+static lba_t nvme_erase(BlockDevOps *me, lba_t start, lba_t count)
+{
+	NvmeDrive *drive = container_of(me, NvmeDrive, dev.ops);
+	NvmeCtrlr *ctrlr = drive->ctrlr;
+	lba_t orig_count = count;
+	NVME_SQ *sq;
+	int status = NVME_SUCCESS;
+
+	if (drive->dsm_ranges == NULL) {
+		drive->dsm_ranges = dma_memalign(NVME_PAGE_SIZE,
+			NVME_DSM_MAX_RANGES * sizeof(NVME_DSM_RANGE));
+		if (drive->dsm_ranges == NULL) {
+			printf("nvme_erase: ERROR - out of memory\n");
+			return -1;
+		}
+	}
+
+	while (count > 0) {
+		int nr = 0;
+
+		/* The range list is reused, so send one command at a time */
+		while (count > 0 && nr < NVME_DSM_MAX_RANGES) {
+			uint32_t blocks = MIN(count, UINT32_MAX);
+
+			drive->dsm_ranges[nr].cattr = 0;
+			drive->dsm_ranges[nr].nlb = blocks;
+			drive->dsm_ranges[nr].slba = start;
+			nr++;
+
+			start += blocks;
+			count -= blocks;
+		}
+
+		status = nvme_next_io_sq(ctrlr, &sq);
+		if (NVME_ERROR(status))
+			break;
+
+		sq->opc = NVME_IO_DSM_OPC;
+		sq->cid = ctrlr->cid[NVME_IO_QUEUE_INDEX]++;
+		sq->nsid = drive->namespace_id;
+		/* Range list is 4KiB at most. Fits in aligned 1 PAGE */
+		sq->prp[0] = (uintptr_t)virt_to_phys(drive->dsm_ranges);
+		sq->cdw10 = nr - 1;
+		sq->cdw11 = NVME_IO_DSM_AD;
+
+		status = nvme_submit_cmd(ctrlr, NVME_IO_QUEUE_INDEX, ctrlr->iosq_sz);
+		if (NVME_ERROR(status))
+			break;
+
+		/* Submit commands to controller */
+		nvme_ring_sq_doorbell(ctrlr, NVME_IO_QUEUE_INDEX);
+		/* Complete submitted command(s) */
+		status = nvme_complete_cmds_polled(ctrlr,
+				NVME_IO_QUEUE_INDEX,
+				NVME_CCQ_SIZE,
+				NVME_GENERIC_TIMEOUT);
+		if (NVME_ERROR(status))
+			break;
+	}
+
+	if (NVME_ERROR(status)) {
+		printf("nvme_erase: error %d\n",status);
+		return -1;
+	}
+
+	return orig_count - count;
+}
+
 /* Sends the Identify command, saves result in ctrlr->controller_data*/
 static NVME_STATUS nvme_identify(NvmeCtrlr *ctrlr) {
 	NVME_SQ *sq;
@@ -687,8 +813,11 @@ static NVME_STATUS nvme_identify(NvmeCtrlr *ctrlr) {
 }
 
 static NVME_STATUS nvme_create_drive(NvmeCtrlr *ctrlr, uint32_t namespace_id,
-				     unsigned int block_size, lba_t block_count)
+				     unsigned int block_size, lba_t block_count,
+				     uint8_t dlfeat)
 {
+	uint8_t dealloc_read = dlfeat & NVME_DLFEAT_READ_MASK;
+
 	/* Create drive node. */
 	NvmeDrive *nvme_drive = xzalloc(sizeof(*nvme_drive));
 	static const int name_size = 21;
@@ -696,6 +825,7 @@ static NVME_STATUS nvme_create_drive(NvmeCtrlr *ctrlr, uint32_t namespace_id,
 	snprintf(name, name_size, "NVMe Namespace %d", namespace_id);
 	nvme_drive->dev.ops.read = &nvme_read;
 	nvme_drive->dev.ops.write = &nvme_write;
+	nvme_drive->dev.ops.fill_write = &nvme_fill_write;
 	nvme_drive->dev.ops.new_stream = &new_simple_stream;
 	nvme_drive->dev.name = name;
 	nvme_drive->dev.removable = 0;
@@ -704,6 +834,19 @@ static NVME_STATUS nvme_create_drive(NvmeCtrlr *ctrlr, uint32_t namespace_id,
 	nvme_drive->ctrlr = ctrlr;
 	nvme_drive->namespace_id = namespace_id;
 
+	if (ctrlr->controller_data->oncs & NVME_ONCS_WRITE_ZEROES)
+		nvme_drive->dev.caps |= BLOCKDEV_CAP_FILL_ZERO;
+	/*
+	 * Only deallocate on erase if the namespace reports what deallocated
+	 * blocks read back as. Otherwise erases fall back to filling.
+	 */
+	if ((ctrlr->controller_data->oncs & NVME_ONCS_DSM) &&
+	    (dealloc_read == NVME_DLFEAT_READ_ZEROES ||
+	     dealloc_read == NVME_DLFEAT_READ_ONES)) {
+		nvme_drive->dev.ops.erase = &nvme_erase;
+		nvme_drive->dev.caps |= BLOCKDEV_CAP_DISCARD;
+	}
+
 	list_insert_after(&nvme_drive->dev.list_node, &fixed_block_devices);
 	list_insert_after(&nvme_drive->list_node, &ctrlr->drives);
 
@@ -770,7 +913,8 @@ static NVME_STATUS nvme_identify_namespaces(NvmeCtrlr *ctrlr) {
 				2 << (namespace_data->lba_format[
 				      namespace_data->flbas & 0xF].lbads - 1);
 			status = nvme_create_drive(ctrlr, index, block_size,
-						   namespace_data->nsze);
+						   namespace_data->nsze,
+						   namespace_data->dlfeat);
 			if (NVME_ERROR(status))
 				goto exit;
 		}
@@ -959,7 +1103,7 @@ static int nvme_ctrlr_init(BlockDevCtrlrOps *me)
 		/* Create drive based on static namespace data */
 		DEBUG(printf("Skip Identify Namespace and use static data\n");)
 		status = nvme_create_drive(ctrlr, ctrlr->namespace_id,
-				   ctrlr->block_size, ctrlr->block_count);
+				   ctrlr->block_size, ctrlr->block_count, 0);
 	} else {
 		/* Identify Namespace and create drive nodes */
 		status = nvme_identify_namespaces(ctrlr);
@@ -183,6 +183,14 @@ typedef uint32_t NVME_CQHDBL;
 #define NVME_IO_FLUSH_OPC	0
 #define NVME_IO_WRITE_OPC	1
 #define NVME_IO_READ_OPC	2
+#define NVME_IO_WRITE_ZEROES_OPC	8
+#define NVME_IO_DSM_OPC	9
+#define  NVME_IO_DSM_AD	(1 << 2)	/* Attribute - Deallocate */
+
+/* Write Zeroes NLB is a 16-bit, 0's based field */
+#define NVME_WRITE_ZEROES_MAX_BLOCKS	0x10000
+/* Dataset Management NR is an 8-bit, 0's based field */
+#define NVME_DSM_MAX_RANGES	256
 
 /* Submission Queue */
 typedef struct {
@@ -258,6 +266,8 @@ typedef struct {
 	uint16_t rsvd3;	/* Reserved as of Nvm Express 1.1 Spec */
 	uint32_t nn;	/* Number of Namespaces */
 	uint16_t oncs;	/* Optional NVM Command Support */
+#define NVME_ONCS_DSM		(1 << 2)
+#define NVME_ONCS_WRITE_ZEROES	(1 << 3)
 	uint16_t fuses;	/* Fused Operation Support */
 	uint8_t  fna;	/* Format NVM Attributes */
 	uint8_t  vwc;	/* Volatile Write Cache */
@@ -300,7 +310,12 @@ typedef struct {
 	uint8_t  dps;	/* End-to-end Data Protection Type Settings */
 	uint8_t  nmic;	/* Namespace Multi-path I/O + NS Sharing Caps */
 	uint8_t  rescap;	/* Reservation Capabilities */
-	uint8_t  rsvd1[88];	/* Reserved as of Nvm Express 1.1 Spec */
+	uint8_t  fpi;	/* Format Progress Indicator */
+	uint8_t  dlfeat;	/* Deallocate Logical Block Features */
+#define NVME_DLFEAT_READ_MASK		0x7
+#define NVME_DLFEAT_READ_ZEROES		1
+#define NVME_DLFEAT_READ_ONES		2
+	uint8_t  rsvd1[86];	/* Not used by this driver */
 	uint64_t eui64;	/* IEEE Extended Unique Identifier */
 
 	NVME_LBAFORMAT lba_format[16];
@@ -313,6 +328,13 @@ typedef struct PrpList {
 	uint64_t prp_entry[PRP_ENTRIES_PER_LIST];
 } PrpList;
 
+/* Dataset Management Range */
+typedef struct {
+	uint32_t cattr;	/* Context Attributes */
+	uint32_t nlb;	/* Length in logical blocks */
+	uint64_t slba;	/* Starting LBA */
+} NVME_DSM_RANGE;
+
 /*
  * Driver Types
  */
@@ -366,6 +388,9 @@ typedef struct NvmeDrive {
 	NvmeCtrlr *ctrlr;
 	uint32_t namespace_id;
 
+	/* Dataset Management range list, allocated on first erase */
+	NVME_DSM_RANGE *dsm_ranges;
+
 	ListNode list_node;
 } NvmeDrive;
 
@@ -150,6 +150,12 @@ static int tpm_sync(void)
 	return 1;
 }
 
+/* Cr50 may go to sleep after this long without SPI traffic. */
+#define TPM_SLEEP_TIMEOUT_US (1 * USECS_PER_SEC)
+
+/* When the last transaction was started, 0 if never. */
+static uint64_t last_transaction_us;
+
 /*
  * Each TPM2 SPI transaction starts the same: CS is asserted, the 4 byte
  * header is sent to the TPM, the master waits til TPM is ready to continue.
@@ -166,11 +172,19 @@ static int start_transaction(int read_write, size_t bytes, unsigned addr)
 	/* Wait for tpm to finish previous transaction */
 	tpm_sync();
 
-	/* Try to wake cr50 if it is asleep. */
-	tpm_if.cs_assert(tpm_if.slave);
-	udelay(1);
-	tpm_if.cs_deassert(tpm_if.slave);
-	udelay(100);
+	/*
+	 * Try to wake cr50 if it is asleep. It only goes to sleep after a
+	 * while without any traffic, so don't bother if we talked to it
+	 * recently.
+	 */
+	if (!last_transaction_us ||
+	    timer_us(last_transaction_us) >= TPM_SLEEP_TIMEOUT_US) {
+		tpm_if.cs_assert(tpm_if.slave);
+		udelay(1);
+		tpm_if.cs_deassert(tpm_if.slave);
+		udelay(100);
+	}
+	last_transaction_us = timer_us(0);
 
 	/*
 	 * The first byte of the frame header encodes the transaction type
@@ -446,6 +460,15 @@ static int tpm2_init(SpiOps *spi_ops)
  * failure.
  */
 #define MAX_STATUS_TIMEOUT 120
+
+/*
+ * How long to wait before checking the status register again. The TPM
+ * interrupt can't be used to cut this short: it's the per-transaction flow
+ * control pulse which only tpm_sync() may consume, not a "command done"
+ * signal.
+ */
+#define STATUS_POLL_INTERVAL_US 100
+
 static int wait_for_status(uint32_t status_mask, uint32_t status_expected)
 {
 	uint32_t status;
@@ -453,7 +476,7 @@ static int wait_for_status(uint32_t status_mask, uint32_t status_expected)
 
 	stopwatch_init_usecs_expire(&sw, MAX_STATUS_TIMEOUT * USECS_PER_SEC);
 	do {
-		udelay(MSECS_PER_SEC);
+		udelay(STATUS_POLL_INTERVAL_US);
 		if (stopwatch_expired(&sw)) {
 			printf("failed to get expected status %x\n",
 			       status_expected);
@@ -479,20 +502,24 @@ union fifo_transfer_buffer {
 /*
  * Transfer requested number of bytes to or from TPM FIFO, accounting for the
  * current burst count value.
+ *
+ * The burst count is how many bytes the TPM is ready to take or hand out
+ * without further flow control, so it only needs to be read again once that
+ * many bytes have been moved, not before every SPI transaction.
  */
 static void fifo_transfer(size_t transfer_size,
 			  union fifo_transfer_buffer buffer,
 			  enum fifo_transfer_direction direction)
 {
 	size_t transaction_size;
-	size_t burst_count;
+	size_t burst_count = 0;
 	size_t handled_so_far = 0;
 
 	do {
-		do {
+		while (!burst_count) {
 			/* Could be zero when TPM is busy. */
 			burst_count = get_burst_count();
-		} while (!burst_count);
+		}
 
 		transaction_size = transfer_size - handled_so_far;
 		transaction_size = MIN(transaction_size, burst_count);
@@ -513,6 +540,7 @@ static void fifo_transfer(size_t transfer_size,
 				       transaction_size);
 
 		handled_so_far += transaction_size;
+		burst_count -= transaction_size;
 
 	} while (handled_so_far != transfer_size);
 }
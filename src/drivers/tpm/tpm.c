@@ -22,6 +22,17 @@
 
 static TpmOps *tpm_ops;
 
+/* Latency of the first TpmTimingEntries commands, and the overall total. */
+enum { TpmTimingEntries = 32 };
+static struct {
+	struct {
+		uint32_t ordinal;
+		uint32_t us;
+	} cmds[TpmTimingEntries];
+	int count;
+	uint64_t total_us;
+} tpm_timing;
+
 void tpm_set_ops(TpmOps *ops)
 {
 	die_if(tpm_ops, "%s: TPM ops already set.\n", __func__);
@@ -34,8 +45,42 @@ void tpm_set_ops(TpmOps *ops)
 int tpm_xmit(const uint8_t *sendbuf, size_t send_size,
 	     uint8_t *recvbuf, size_t *recv_len)
 {
+	uint32_t ordinal = 0;
+	uint64_t start, us;
+	int ret;
+
 	die_if(!tpm_ops, "%s: No TPM ops set.\n", __func__);
-	return tpm_ops->xmit(tpm_ops, sendbuf, send_size, recvbuf, recv_len);
+
+	if (send_size >= TpmCmdOrdinalOffset + sizeof(ordinal)) {
+		memcpy(&ordinal, sendbuf + TpmCmdOrdinalOffset,
+		       sizeof(ordinal));
+		ordinal = betohl(ordinal);
+	}
+
+	start = timer_us(0);
+	ret = tpm_ops->xmit(tpm_ops, sendbuf, send_size, recvbuf, recv_len);
+	us = timer_us(start);
+
+	if (tpm_timing.count < TpmTimingEntries) {
+		tpm_timing.cmds[tpm_timing.count].ordinal = ordinal;
+		tpm_timing.cmds[tpm_timing.count].us = us;
+	}
+	tpm_timing.count++;
+	tpm_timing.total_us += us;
+
+	return ret;
+}
+
+void tpm_report_timing(void)
+{
+	if (!tpm_timing.count)
+		return;
+
+	printf("TPM: %d commands took %lluus\n", tpm_timing.count,
+	       tpm_timing.total_us);
+	for (int i = 0; i < MIN(tpm_timing.count, TpmTimingEntries); i++)
+		printf("TPM:   ordinal %#010x took %uus\n",
+		       tpm_timing.cmds[i].ordinal, tpm_timing.cmds[i].us);
 }
 
 char *tpm_report_state(void)
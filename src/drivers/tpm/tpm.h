@@ -77,6 +77,13 @@ void tpm_set_ops(TpmOps *ops);
 int tpm_xmit(const uint8_t *sendbuf, size_t send_size,
 	     uint8_t *recvbuf, size_t *recv_len);
 
+/*
+ * tpm_report_timing()
+ *
+ * Print how long each TPM command sent so far took, and the total.
+ */
+void tpm_report_timing(void);
+
 /*
  * tpm_internal_state()
  *
@@ -20,17 +20,45 @@
 #include <sysinfo.h>
 
 #include "base/bitmap.h"
+#include "base/list.h"
+#include "config.h"
 #include "drivers/video/coreboot_fb.h"
 
-static inline void dc_corebootfb_draw_pixel(uint32_t x, uint32_t y,
-					    uint32_t red, uint32_t green,
-					    uint32_t blue,
-					    struct cb_framebuffer *fbinfo,
-					    unsigned char *fbaddr)
+/*
+ * Decoded bitmaps are cached in the framebuffer's native pixel format, so
+ * that redrawing the same image is a row by row copy.
+ */
+typedef struct BitmapCacheEntry
+{
+	/* Identifies the source bitmap and the framebuffer format. */
+	uint64_t hash;
+	uint32_t file_size;
+	uint32_t format;
+	/* Native pixels, top row first. */
+	int32_t width;
+	int32_t height;
+	uint8_t *pixels;
+	size_t size;
+	ListNode list_node;
+} BitmapCacheEntry;
+
+/* Bitmaps that don't fit in this share of the heap are drawn uncached. */
+#define BITMAP_CACHE_MAX_BYTES	(CONFIG_HEAP_SIZE / 8)
+
+static ListNode bitmap_cache;
+static size_t bitmap_cache_bytes;
+
+static uint32_t dc_corebootfb_format(struct cb_framebuffer *fbinfo)
 {
-	const uint32_t xres = fbinfo->x_resolution;
-	const int bpp = fbinfo->bits_per_pixel;
+	return fbinfo->bits_per_pixel |
+	       fbinfo->red_mask_pos << 8 | fbinfo->green_mask_pos << 16 |
+	       fbinfo->blue_mask_pos << 24;
+}
 
+static uint32_t dc_corebootfb_color(struct cb_framebuffer *fbinfo,
+				    uint32_t red, uint32_t green,
+				    uint32_t blue)
+{
 	uint32_t color = 0;
 	color |= (red >> (8 - fbinfo->red_mask_size))
 		<< fbinfo->red_mask_pos;
@@ -38,10 +66,78 @@ static inline void dc_corebootfb_draw_pixel(uint32_t x, uint32_t y,
 		<< fbinfo->green_mask_pos;
 	color |= (blue >> (8 - fbinfo->blue_mask_size))
 		<< fbinfo->blue_mask_pos;
+	return color;
+}
+
+/*
+ * 64-bit FNV-1a over the whole file. Together with the file size this tells
+ * the bitmaps in the firmware image apart without keeping a copy of each.
+ */
+static uint64_t dc_corebootfb_hash(const uint8_t *data, uint32_t size)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (uint32_t i = 0; i < size; i++)
+		hash = (hash ^ data[i]) * 1099511628211ULL;
+	return hash;
+}
 
-	uint8_t *pixel = fbaddr + (x + y * xres) * bpp / 8;
-	for (int i = 0; i < bpp / 8; i++)
-		pixel[i] = (color >> (i * 8));
+static BitmapCacheEntry *dc_corebootfb_cache_find(uint64_t hash,
+						  uint32_t file_size,
+						  uint32_t format)
+{
+	BitmapCacheEntry *entry;
+
+	list_for_each(entry, bitmap_cache, list_node) {
+		if (entry->hash == hash && entry->file_size == file_size &&
+		    entry->format == format) {
+			// Keep recently drawn bitmaps at the front.
+			list_remove(&entry->list_node);
+			list_insert_after(&entry->list_node, &bitmap_cache);
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static void dc_corebootfb_cache_add(BitmapCacheEntry *new)
+{
+	BitmapCacheEntry *entry, *last;
+
+	// Evict the least recently drawn bitmaps to stay within budget.
+	while (bitmap_cache_bytes + new->size > BITMAP_CACHE_MAX_BYTES &&
+	       bitmap_cache.next) {
+		last = NULL;
+		list_for_each(entry, bitmap_cache, list_node)
+			last = entry;
+		list_remove(&last->list_node);
+		bitmap_cache_bytes -= last->size;
+		free(last->pixels);
+		free(last);
+	}
+
+	list_insert_after(&new->list_node, &bitmap_cache);
+	bitmap_cache_bytes += new->size;
+}
+
+static void dc_corebootfb_blit(uint32_t x, uint32_t y,
+			       BitmapCacheEntry *entry,
+			       struct cb_framebuffer *fbinfo,
+			       unsigned char *fbaddr)
+{
+	const int bytes_pp = fbinfo->bits_per_pixel / 8;
+	uint32_t width = entry->width, height = entry->height;
+
+	if (x >= fbinfo->x_resolution || y >= fbinfo->y_resolution)
+		return;
+	width = MIN(width, fbinfo->x_resolution - x);
+	height = MIN(height, fbinfo->y_resolution - y);
+
+	for (uint32_t row = 0; row < height; row++)
+		memcpy(fbaddr + (y + row) * fbinfo->bytes_per_line +
+		       x * bytes_pp,
+		       entry->pixels + row * entry->width * bytes_pp,
+		       width * bytes_pp);
 }
 
 static int dc_corebootfb_draw_bitmap_v2(uint32_t x, uint32_t y,
@@ -59,9 +155,24 @@ static int dc_corebootfb_draw_bitmap_v3(uint32_t x, uint32_t y,
 					unsigned char *fbaddr)
 {
 	BitmapFileHeader *file_header_ptr = (BitmapFileHeader *)bitmap;
-	uint32_t bitmap_offset;
+	uint32_t bitmap_offset, file_size;
 	memcpy(&bitmap_offset, &file_header_ptr->bitmap_offset,
 		sizeof(bitmap_offset));
+	memcpy(&file_size, &file_header_ptr->file_size, sizeof(file_size));
+	if (file_size <= bitmap_offset) {
+		printf("Invalid bitmap file size.\n");
+		return -1;
+	}
+
+	const uint32_t format = dc_corebootfb_format(fbinfo);
+	const uint64_t hash = dc_corebootfb_hash(bitmap, file_size);
+	BitmapCacheEntry *entry = dc_corebootfb_cache_find(hash, file_size,
+							   format);
+	if (entry) {
+		dc_corebootfb_blit(x, y, entry, fbinfo, fbaddr);
+		return 0;
+	}
+
 	BitmapHeaderV3 header;
 	memcpy(&header, (uint8_t *)bitmap + sizeof(BitmapFileHeader),
 		sizeof(header));
@@ -77,24 +188,75 @@ static int dc_corebootfb_draw_bitmap_v3(uint32_t x, uint32_t y,
 		return -1;
 	}
 
+	// Convert the palette to the framebuffer format once up front.
 	uintptr_t palette_offset =
 		sizeof(BitmapFileHeader) + sizeof(BitmapHeaderV3);
-	int palette_size = bitmap_offset - palette_offset;
-	BitmapPaletteElementV3 *palette = xmalloc(palette_size);
-	memcpy(palette, (uint8_t *)bitmap + palette_offset, palette_size);
+	int palette_count = (bitmap_offset - palette_offset) /
+		sizeof(BitmapPaletteElementV3);
+	BitmapPaletteElementV3 *palette =
+		(BitmapPaletteElementV3 *)((uint8_t *)bitmap + palette_offset);
+	uint32_t colors[256] = { 0 };
+	for (int i = 0; i < MIN(palette_count, 1 << bpp); i++) {
+		BitmapPaletteElementV3 element;
+		memcpy(&element, &palette[i], sizeof(element));
+		colors[i] = dc_corebootfb_color(fbinfo, element.red,
+						element.green, element.blue);
+	}
 
 	int32_t width = header.width, height = header.height;
+	if (width <= 0 || height == 0)
+		return 0;
 	int extra = width % 4;
 	const int32_t padding = extra ? (4 - extra) : 0;
+	const int bytes_pp = fbinfo->bits_per_pixel / 8;
 	int32_t ystep = -1;
+	uint32_t y_offset;
 	if (height < 0) {
 		height = -height;
 		ystep = -ystep;
+		y_offset = 0;
 	} else {
-		y += height - 1;
+		y_offset = height - 1;
+	}
+
+	/*
+	 * Decode into a new cache entry if it fits, otherwise straight into
+	 * the visible part of the framebuffer.
+	 */
+	const size_t size = (size_t)width * height * bytes_pp;
+	uint8_t *pixels = NULL;
+	uint32_t stride, visible_width, visible_height;
+	if (size <= BITMAP_CACHE_MAX_BYTES)
+		entry = malloc(sizeof(*entry));
+	if (entry) {
+		pixels = malloc(size);
+		if (!pixels) {
+			free(entry);
+			entry = NULL;
+		}
 	}
+	if (entry) {
+		entry->hash = hash;
+		entry->file_size = file_size;
+		entry->format = format;
+		entry->width = width;
+		entry->height = height;
+		entry->size = size;
+		entry->pixels = pixels;
+		stride = width * bytes_pp;
+		visible_width = width;
+		visible_height = height;
+	} else {
+		if (x >= fbinfo->x_resolution || y >= fbinfo->y_resolution)
+			return 0;
+		pixels = fbaddr + y * fbinfo->bytes_per_line + x * bytes_pp;
+		stride = fbinfo->bytes_per_line;
+		visible_width = MIN(width, fbinfo->x_resolution - x);
+		visible_height = MIN(height, fbinfo->y_resolution - y);
+	}
+
 	uint8_t *cur_data = (uint8_t *)bitmap + bitmap_offset;
-	uint32_t x_offset = 0, y_offset = 0;
+	uint32_t x_offset = 0;
 	int bit = 0;
 	// Loop over all the pixels in the image.
 	for (uint32_t pixel = 0; pixel < width * height; pixel++) {
@@ -119,14 +281,13 @@ static int dc_corebootfb_draw_bitmap_v3(uint32_t x, uint32_t y,
 			}
 		}
 
-		// Actually draw that pixel on the display.
-		dc_corebootfb_draw_pixel(x + x_offset,
-					 y + y_offset,
-					 palette[index].red,
-					 palette[index].green,
-					 palette[index].blue,
-					 fbinfo,
-					 fbaddr);
+		// Store the pixel in the native format.
+		if (x_offset < visible_width && y_offset < visible_height) {
+			uint8_t *out = pixels + y_offset * stride +
+				x_offset * bytes_pp;
+			for (int i = 0; i < bytes_pp; i++)
+				out[i] = colors[index] >> (i * 8);
+		}
 
 		// Keep track of position.
 		if (++x_offset == width) {
@@ -135,7 +296,11 @@ static int dc_corebootfb_draw_bitmap_v3(uint32_t x, uint32_t y,
 			cur_data += padding;
 		}
 	}
-	free(palette);
+
+	if (entry) {
+		dc_corebootfb_cache_add(entry);
+		dc_corebootfb_blit(x, y, entry, fbinfo, fbaddr);
+	}
 	return 0;
 }
 
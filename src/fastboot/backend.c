@@ -18,6 +18,7 @@
 #include <libpayload.h>
 
 #include "base/gpt.h"
+#include "boot/crc32.h"
 #include "config.h"
 #include "fastboot/backend.h"
 
@@ -51,6 +52,11 @@ backend_ret_t __attribute__((weak)) board_write_partition(const char *name,
 	return BE_NOT_HANDLED;
 }
 
+int __attribute__((weak)) board_can_stream_partition(const char *name)
+{
+	return 1;
+}
+
 
 /********************** Sparse Image Handling ****************************/
 
@@ -98,61 +104,235 @@ int is_sparse_image(void *image_addr)
 		(hdr->major_version == 0x1));
 }
 
-struct img_buff {
-	void *data;
-	uint64_t size;
+/********************** Streaming Image Writer ***************************/
+
+/*
+ * The image is consumed in arbitrarily sized pieces so that it can be written
+ * to the block device while the rest of it is still being received. Headers
+ * and partial blocks that straddle two pieces are staged in s->stage.
+ */
+enum stream_state {
+	STREAM_IMG_HDR,
+	STREAM_CHUNK_HDR,
+	STREAM_RAW,
+	STREAM_FILL,
+	STREAM_CRC32,
+	STREAM_DONE,
 };
 
 /*
- * Initialize img_buff structure with passed in data and size. Verifies that
- * buff and data is not NULL.
- * Returns 0 on success and -1 on error.
+ * Operations on the block device are not issued per chunk. Instead, the last
+ * one is kept pending and extended by following chunks that continue it on the
+ * device: small raw chunks are gathered into the merge buffer, fill chunks with
+ * the same pattern and don't care chunks are combined into single requests.
  */
-static int img_buff_init(struct img_buff *buff, void *data, uint64_t size)
+enum extent_type {
+	EXTENT_NONE,
+	EXTENT_RAW,
+	EXTENT_FILL,
+	EXTENT_DISCARD,
+};
+
+struct stream_extent {
+	enum extent_type type;
+	uint64_t addr;
+	uint64_t count;
+	uint32_t fill;
+};
+
+/* Size of buffer used to merge raw chunks */
+#define STREAM_MERGE_SIZE	(1 * MiB)
+
+struct backend_stream {
+	BlockDevOps *ops;
+	uint64_t block_size;
+	/* Can don't care chunks be discarded rather than skipped? */
+	int discard;
+	/* Total image size announced by the host */
+	uint64_t image_size;
+	enum stream_state state;
+	/* First error encountered, returned by all following calls */
+	backend_ret_t ret;
+	/* Is this a sparse image? 1-yes, 0-no */
+	int sparse;
+	struct sparse_image_hdr img_hdr;
+	struct sparse_chunk_hdr chunk_hdr;
+	uint32_t chunk_index;
+	/* CRC32 of the expanded image data so far */
+	uint32_t crc;
+	/* Size in lba of the area occupied by current chunk */
+	uint64_t chunk_size_lba;
+	/* Raw data bytes of current chunk not yet received */
+	uint64_t raw_left;
+	/* Next lba to be written with raw data */
+	uint64_t raw_addr;
+	/* Start of current chunk and remaining size of partition in lba */
+	uint64_t part_addr;
+	uint64_t part_size_lba;
+	uint8_t *stage;
+	size_t stage_len;
+	/* Pending device operation that following chunks may extend */
+	struct stream_extent pend;
+	/* Raw data of pending RAW extent, merge_max_lba blocks large */
+	uint8_t *merge;
+	uint64_t merge_max_lba;
+};
+
+/* Issue the pending extent to the block device. */
+static backend_ret_t stream_flush(struct backend_stream *s)
 {
-	if ((buff == NULL) || (data == NULL))
-		return -1;
+	BlockDevOps *ops = s->ops;
+	struct stream_extent *pend = &s->pend;
+	uint64_t count = pend->count;
+	uint64_t ret;
+
+	switch (pend->type) {
+	case EXTENT_RAW:
+		ret = ops->write(ops, pend->addr, pend->count, s->merge);
+		break;
+	case EXTENT_FILL:
+		ret = ops->fill_write(ops, pend->addr, pend->count, pend->fill);
+		break;
+	case EXTENT_DISCARD:
+		/* Contents don't matter, so a failed discard is harmless. */
+		ops->erase(ops, pend->addr, pend->count);
+		ret = count;
+		break;
+	default:
+		ret = count;
+		break;
+	}
 
-	buff->data = data;
-	buff->size = size;
+	pend->type = EXTENT_NONE;
+	pend->count = 0;
 
-	return 0;
+	if (ret != count)
+		return BE_WRITE_ERR;
+
+	return BE_SUCCESS;
+}
+
+/* Can the pending extent be extended by count blocks of type at addr? */
+static int stream_extends(struct backend_stream *s, enum extent_type type,
+			  uint64_t addr, uint64_t count)
+{
+	struct stream_extent *pend = &s->pend;
+
+	if ((pend->type != type) || (pend->addr + pend->count != addr))
+		return 0;
+
+	if (type == EXTENT_RAW)
+		return pend->count + count <= s->merge_max_lba;
+
+	return 1;
 }
 
 /*
- * Obtain current pointer to data and advance data pointer by size. If there is
- * not enough data to advance, then it returns NULL.
+ * Queue an operation of type on count blocks at addr, flushing the pending
+ * extent first unless the new operation continues it.
  */
-static void *img_buff_advance(struct img_buff *buff, uint64_t size)
+static backend_ret_t stream_queue(struct backend_stream *s,
+				  enum extent_type type, uint64_t addr,
+				  uint64_t count, uint32_t fill)
 {
-	void *data;
+	struct stream_extent *pend = &s->pend;
+	backend_ret_t ret;
 
-	if (buff->size < size)
-		return NULL;
+	if (count == 0)
+		return BE_SUCCESS;
+
+	if (!stream_extends(s, type, addr, count) ||
+	    ((type == EXTENT_FILL) && (pend->fill != fill))) {
+		ret = stream_flush(s);
+		if (ret != BE_SUCCESS)
+			return ret;
+		pend->type = type;
+		pend->addr = addr;
+		pend->fill = fill;
+	}
+
+	pend->count += count;
+	return BE_SUCCESS;
+}
+
+/*
+ * Accumulate bytes in the staging buffer until it holds need bytes. Returns 1
+ * once the staging buffer is complete, 0 if more data is required.
+ */
+static int stream_stage(struct backend_stream *s, size_t need,
+			const uint8_t **data, uint64_t *len)
+{
+	size_t count = MIN(need - s->stage_len, *len);
+
+	memcpy(s->stage + s->stage_len, *data, count);
+	s->stage_len += count;
+	*data += count;
+	*len -= count;
+
+	return s->stage_len == need;
+}
+
+/* Account for the chunk just completed and move on to the next one. */
+static void stream_end_chunk(struct backend_stream *s)
+{
+	s->part_addr += s->chunk_size_lba;
+	s->part_size_lba -= s->chunk_size_lba;
+
+	if (s->sparse && (++s->chunk_index < s->img_hdr.total_chunks))
+		s->state = STREAM_CHUNK_HDR;
+	else
+		s->state = STREAM_DONE;
+}
+
+/* Prepare raw data of size bytes to be written at current partition addr. */
+static void stream_start_raw(struct backend_stream *s, uint64_t size)
+{
+	s->raw_left = size;
+	s->raw_addr = s->part_addr;
+	s->state = STREAM_RAW;
+
+	if (size == 0)
+		stream_end_chunk(s);
+}
+
+static backend_ret_t stream_start_raw_image(struct backend_stream *s)
+{
+	uint64_t image_size_lba;
 
-	data = buff->data;
-	buff->data = (uint8_t *)(buff->data) + size;
-	buff->size -= size;
+	/* Ensure that image size is multiple of block size */
+	if (s->image_size != ALIGN_DOWN(s->image_size, s->block_size))
+		return BE_IMAGE_SIZE_MULTIPLE_ERR;
+
+	image_size_lba = s->image_size / s->block_size;
+
+	/* Ensure image size is less than partition size */
+	if (s->part_size_lba < image_size_lba) {
+		BE_LOG("part_size_lba:%llx\n", s->part_size_lba);
+		BE_LOG("image_size_lba:%llx\n", image_size_lba);
+		return BE_IMAGE_OVERFLOW_ERR;
+	}
+
+	s->chunk_size_lba = image_size_lba;
 
-	return data;
+	/* Whatever was staged while probing for a sparse header is raw data */
+	stream_start_raw(s, s->image_size - s->stage_len);
+	return BE_SUCCESS;
 }
 
-/* Write sparse image to partition */
-static backend_ret_t write_sparse_image(struct image_part_details *img,
-					void *image_addr, uint64_t image_size)
+static backend_ret_t stream_start_image(struct backend_stream *s)
 {
-	struct img_buff buff;
-	struct sparse_image_hdr *img_hdr;
-	struct sparse_chunk_hdr *chunk_hdr;
-	uint64_t bdev_block_size = img->bdev_entry->bdev->block_size;
+	struct sparse_image_hdr *img_hdr = &s->img_hdr;
 
-	if (img_buff_init(&buff, image_addr, image_size))
-		return BE_IMAGE_INSUFFICIENT_DATA;
+	if (!is_sparse_image(s->stage)) {
+		BE_LOG("Writing raw image...\n");
+		return stream_start_raw_image(s);
+	}
 
-	img_hdr = img_buff_advance(&buff, sizeof(*img_hdr));
+	BE_LOG("Writing sparse image...\n");
 
-	if (img_hdr == NULL)
-		return BE_IMAGE_INSUFFICIENT_DATA;
+	memcpy(img_hdr, s->stage, sizeof(*img_hdr));
+	s->stage_len = 0;
+	s->sparse = 1;
 
 	BE_LOG("Magic          : %x\n", img_hdr->magic);
 	BE_LOG("Major Version  : %x\n", img_hdr->major_version);
@@ -169,188 +349,269 @@ static backend_ret_t write_sparse_image(struct image_part_details *img,
 		return BE_SPARSE_HDR_ERR;
 
 	/* Is image block size multiple of bdev block size? */
-	if (img_hdr->blk_size != ALIGN_DOWN(img_hdr->blk_size, bdev_block_size))
+	if (img_hdr->blk_size != ALIGN_DOWN(img_hdr->blk_size, s->block_size))
 		return BE_IMAGE_SIZE_MULTIPLE_ERR;
 
 	/* Is chunk header size as expected? */
-	if (img_hdr->chunk_hdr_size != sizeof(*chunk_hdr))
+	if (img_hdr->chunk_hdr_size != sizeof(struct sparse_chunk_hdr))
 		return BE_CHUNK_HDR_ERR;
 
-	int i;
-	uint64_t part_addr = img->part_addr;
-	uint64_t part_size_lba = img->part_size_lba;
-	BlockDevOps *ops = &img->bdev_entry->bdev->ops;
-
-	/* Perform the following operation on each chunk */
-	for (i = 0; i < img_hdr->total_chunks; i++) {
-		/* Get chunk header */
-		chunk_hdr = img_buff_advance(&buff, sizeof(*chunk_hdr));
-
-		if (chunk_hdr == NULL)
-			return BE_IMAGE_INSUFFICIENT_DATA;
-
-		BE_LOG("Chunk %d\n", i);
-		BE_LOG("Type         : %x\n", chunk_hdr->type);
-		BE_LOG("Size in blks : %x\n", chunk_hdr->size_in_blks);
-		BE_LOG("Total size   : %x\n", chunk_hdr->total_size_bytes);
-		BE_LOG("Part addr    : %llx\n", part_addr);
-
-		/* Size in bytes and lba of the area occupied by chunk range */
-		uint64_t chunk_size_bytes, chunk_size_lba;
-
-		chunk_size_bytes = (uint64_t)chunk_hdr->size_in_blks *
-			img_hdr->blk_size;
-		chunk_size_lba = chunk_size_bytes / bdev_block_size;
-
-		/* Should not write past partition size */
-		if (part_size_lba < chunk_size_lba) {
-			BE_LOG("part_size_lba:%llx\n", part_size_lba);
-			BE_LOG("chunk_size_lba:%llx\n", chunk_size_lba);
-			return BE_IMAGE_OVERFLOW_ERR;
-		}
-
-		switch (chunk_hdr->type) {
-		case CHUNK_TYPE_RAW: {
-
-			uint8_t *data_ptr;
-
-			/*
-			 * For Raw chunk type:
-			 * chunk_size_bytes + chunk_hdr_size = chunk_total_size
-			 */
-			if ((chunk_size_bytes + sizeof(*chunk_hdr))!=
-			    chunk_hdr->total_size_bytes) {
-				BE_LOG("chunk_size_bytes:%llx\n",
-				       chunk_size_bytes + sizeof(*chunk_hdr));
-				BE_LOG("total_size_bytes:%x\n",
-				       chunk_hdr->total_size_bytes);
-				return BE_CHUNK_HDR_ERR;
-			}
+	if (img_hdr->total_chunks == 0)
+		s->state = STREAM_DONE;
+	else
+		s->state = STREAM_CHUNK_HDR;
 
-			data_ptr = img_buff_advance(&buff, chunk_size_bytes);
-			if (data_ptr == NULL)
-				return BE_IMAGE_INSUFFICIENT_DATA;
+	return BE_SUCCESS;
+}
 
-			if (ops->write(ops, part_addr, chunk_size_lba, data_ptr)
-			    != chunk_size_lba)
-				return BE_WRITE_ERR;
+/* Check that the total size of the chunk matches its header and data size. */
+static backend_ret_t stream_check_chunk_size(struct sparse_chunk_hdr *hdr,
+					     uint64_t data_size)
+{
+	if (data_size + sizeof(*hdr) != hdr->total_size_bytes) {
+		BE_LOG("chunk_size_bytes:%llx\n", data_size + sizeof(*hdr));
+		BE_LOG("total_size_bytes:%x\n", hdr->total_size_bytes);
+		return BE_CHUNK_HDR_ERR;
+	}
 
-			break;
-		}
-		case CHUNK_TYPE_FILL: {
-
-			uint32_t *data_fill;
-
-			/*
-			 * For fill chunk type:
-			 * chunk_hdr_size + 4 bytes = chunk_total_size_bytes
-			 */
-			if (sizeof(uint32_t) + sizeof(*chunk_hdr) !=
-			    chunk_hdr->total_size_bytes) {
-				BE_LOG("chunk_size_bytes:%zx\n",
-				       sizeof(uint32_t) + sizeof(*chunk_hdr));
-				BE_LOG("total_size_bytes:%x\n",
-				       chunk_hdr->total_size_bytes);
-				return BE_CHUNK_HDR_ERR;
-			}
+	return BE_SUCCESS;
+}
 
-			data_fill = img_buff_advance(&buff,
-							sizeof(*data_fill));
-			if (!data_fill)
-				return BE_IMAGE_INSUFFICIENT_DATA;
+static backend_ret_t stream_start_chunk(struct backend_stream *s)
+{
+	struct sparse_chunk_hdr *chunk_hdr = &s->chunk_hdr;
+	/* Size in bytes of the area occupied by chunk range */
+	uint64_t chunk_size_bytes;
+	const uint32_t zero = 0;
+	backend_ret_t ret;
 
-			/* Perform fill_write operation */
-			if (ops->fill_write(ops, part_addr, chunk_size_lba,
-					    *data_fill)
-			    != chunk_size_lba)
-				return BE_WRITE_ERR;
+	memcpy(chunk_hdr, s->stage, sizeof(*chunk_hdr));
+	s->stage_len = 0;
 
-			break;
-		}
-		case CHUNK_TYPE_DONT_CARE: {
-			/*
-			 * For dont care chunk type:
-			 * chunk_hdr_size = chunk_total_size_bytes
-			 * data in sparse image = 0 bytes
-			 */
-			if (sizeof(*chunk_hdr) != chunk_hdr->total_size_bytes) {
-				BE_LOG("chunk_size_bytes:%zx\n",
-				       sizeof(*chunk_hdr));
-				BE_LOG("total_size_bytes:%x\n",
-				       chunk_hdr->total_size_bytes);
-				return BE_CHUNK_HDR_ERR;
-			}
-			break;
-		}
-		case CHUNK_TYPE_CRC32: {
-			/*
-			 * For crc32 chunk type:
-			 * chunk_hdr_size + 4 bytes = chunk_total_size_bytes
-			 */
-			if (sizeof(uint32_t) + sizeof(*chunk_hdr) !=
-			    chunk_hdr->total_size_bytes) {
-				BE_LOG("chunk_size_bytes:%zx\n",
-				       sizeof(uint32_t) + sizeof(*chunk_hdr));
-				BE_LOG("total_size_bytes:%x\n",
-				       chunk_hdr->total_size_bytes);
-				return BE_CHUNK_HDR_ERR;
-			}
+	BE_LOG("Chunk %d\n", s->chunk_index);
+	BE_LOG("Type         : %x\n", chunk_hdr->type);
+	BE_LOG("Size in blks : %x\n", chunk_hdr->size_in_blks);
+	BE_LOG("Total size   : %x\n", chunk_hdr->total_size_bytes);
+	BE_LOG("Part addr    : %llx\n", s->part_addr);
 
-			/* TODO(furquan): Verify CRC32 header? */
+	chunk_size_bytes = (uint64_t)chunk_hdr->size_in_blks *
+		s->img_hdr.blk_size;
+	s->chunk_size_lba = chunk_size_bytes / s->block_size;
 
-			/* Data present in chunk sparse image = 4 bytes */
-			if (img_buff_advance(&buff, sizeof(uint32_t)) == NULL)
-				return BE_IMAGE_INSUFFICIENT_DATA;
-			break;
-		}
-		default: {
-			/* Unknown chunk type */
-			BE_LOG("Unknown chunk type %d\n", chunk_hdr->type);
-			return BE_CHUNK_HDR_ERR;
-		}
-		}
-		/* Update partition address and size accordingly */
-		part_addr += chunk_size_lba;
-		part_size_lba -= chunk_size_lba;
+	/* Should not write past partition size */
+	if (s->part_size_lba < s->chunk_size_lba) {
+		BE_LOG("part_size_lba:%llx\n", s->part_size_lba);
+		BE_LOG("chunk_size_lba:%llx\n", s->chunk_size_lba);
+		return BE_IMAGE_OVERFLOW_ERR;
 	}
 
-	return BE_SUCCESS;
+	switch (chunk_hdr->type) {
+	case CHUNK_TYPE_RAW:
+		/*
+		 * For Raw chunk type:
+		 * chunk_size_bytes + chunk_hdr_size = chunk_total_size
+		 */
+		ret = stream_check_chunk_size(chunk_hdr, chunk_size_bytes);
+		if (ret == BE_SUCCESS)
+			stream_start_raw(s, chunk_size_bytes);
+		return ret;
+	case CHUNK_TYPE_FILL:
+		/*
+		 * For fill chunk type:
+		 * chunk_hdr_size + 4 bytes = chunk_total_size_bytes
+		 */
+		s->state = STREAM_FILL;
+		return stream_check_chunk_size(chunk_hdr, sizeof(uint32_t));
+	case CHUNK_TYPE_DONT_CARE:
+		/*
+		 * For dont care chunk type:
+		 * chunk_hdr_size = chunk_total_size_bytes
+		 * data in sparse image = 0 bytes
+		 */
+		ret = stream_check_chunk_size(chunk_hdr, 0);
+		if (ret != BE_SUCCESS)
+			return ret;
+		/* Skipped blocks count as zeroes towards the checksum */
+		s->crc = crc32_repeat(s->crc, &zero, sizeof(zero),
+				      chunk_size_bytes / sizeof(zero));
+		if (s->discard)
+			ret = stream_queue(s, EXTENT_DISCARD, s->part_addr,
+					   s->chunk_size_lba, 0);
+		if (ret == BE_SUCCESS)
+			stream_end_chunk(s);
+		return ret;
+	case CHUNK_TYPE_CRC32:
+		/*
+		 * For crc32 chunk type:
+		 * chunk_hdr_size + 4 bytes = chunk_total_size_bytes
+		 */
+		s->state = STREAM_CRC32;
+		return stream_check_chunk_size(chunk_hdr, sizeof(uint32_t));
+	default:
+		/* Unknown chunk type */
+		BE_LOG("Unknown chunk type %d\n", chunk_hdr->type);
+		return BE_CHUNK_HDR_ERR;
+	}
 }
 
-/********************** Raw Image Handling *******************************/
+static backend_ret_t stream_write_blocks(struct backend_stream *s,
+					 const void *data, uint64_t count)
+{
+	BlockDevOps *ops = s->ops;
+	struct stream_extent *pend = &s->pend;
+	uint64_t addr = s->raw_addr;
+	backend_ret_t ret;
+
+	s->raw_addr += count;
+
+	if (s->sparse)
+		s->crc = crc32(s->crc, data, count * s->block_size);
+
+	if (stream_extends(s, EXTENT_RAW, addr, count)) {
+		memcpy(s->merge + pend->count * s->block_size, data,
+		       count * s->block_size);
+		pend->count += count;
+		return BE_SUCCESS;
+	}
+
+	ret = stream_flush(s);
+	if (ret != BE_SUCCESS)
+		return ret;
+
+	/* Large runs are written straight from the caller's buffer. */
+	if (count >= s->merge_max_lba) {
+		if (ops->write(ops, addr, count, data) != count)
+			return BE_WRITE_ERR;
+		return BE_SUCCESS;
+	}
+
+	memcpy(s->merge, data, count * s->block_size);
+	return stream_queue(s, EXTENT_RAW, addr, count, 0);
+}
 
-static backend_ret_t write_raw_image(struct image_part_details *img,
-				     void *image_addr, uint64_t image_size)
+/*
+ * Write as much raw data as is available. Whole blocks are written straight
+ * from the caller's buffer, a trailing partial block is staged until the rest
+ * of it arrives.
+ */
+static backend_ret_t stream_raw(struct backend_stream *s,
+				const uint8_t **data, uint64_t *len)
 {
-	struct bdev_info *bdev_entry = img->bdev_entry;
-	uint64_t part_addr = img->part_addr;
-	uint64_t part_size_lba = img->part_size_lba;
-	uint64_t image_size_lba;
+	uint64_t avail = MIN(*len, s->raw_left);
+	uint64_t count;
+	backend_ret_t ret;
 
-	BlockDevOps *ops = &bdev_entry->bdev->ops;
+	s->raw_left -= avail;
+	*len -= avail;
 
-	uint64_t block_size = bdev_entry->bdev->block_size;
+	if (s->stage_len) {
+		count = MIN(s->block_size - s->stage_len, avail);
+		memcpy(s->stage + s->stage_len, *data, count);
+		s->stage_len += count;
+		*data += count;
+		avail -= count;
 
-	/* Ensure that image size is multiple of block size */
-	if (image_size != ALIGN_DOWN(image_size, block_size))
-		return BE_IMAGE_SIZE_MULTIPLE_ERR;
+		if (s->stage_len < s->block_size)
+			return BE_SUCCESS;
 
-	image_size_lba = image_size / block_size;
+		s->stage_len = 0;
+		ret = stream_write_blocks(s, s->stage, 1);
+		if (ret != BE_SUCCESS)
+			return ret;
+	}
 
-	/* Ensure image size is less than partition size */
-	if (part_size_lba < image_size_lba) {
-		BE_LOG("part_size_lba:%llx\n", part_size_lba);
-		BE_LOG("image_size_lba:%llx\n", image_size_lba);
-		return BE_IMAGE_OVERFLOW_ERR;
+	count = avail / s->block_size;
+	if (count) {
+		ret = stream_write_blocks(s, *data, count);
+		if (ret != BE_SUCCESS)
+			return ret;
+		*data += count * s->block_size;
+		avail -= count * s->block_size;
 	}
 
-	if (ops->write(ops, part_addr, image_size_lba, image_addr) !=
-	    image_size_lba)
-		return BE_WRITE_ERR;
+	memcpy(s->stage, *data, avail);
+	s->stage_len = avail;
+	*data += avail;
+
+	if ((s->raw_left == 0) && (s->stage_len == 0))
+		stream_end_chunk(s);
 
 	return BE_SUCCESS;
 }
 
+static backend_ret_t stream_fill(struct backend_stream *s)
+{
+	uint32_t data_fill;
+	backend_ret_t ret;
+
+	memcpy(&data_fill, s->stage, sizeof(data_fill));
+	s->stage_len = 0;
+
+	s->crc = crc32_repeat(s->crc, &data_fill, sizeof(data_fill),
+			      s->chunk_size_lba * s->block_size /
+			      sizeof(data_fill));
+
+	/* Perform fill_write operation */
+	ret = stream_queue(s, EXTENT_FILL, s->part_addr, s->chunk_size_lba,
+			   data_fill);
+	if (ret == BE_SUCCESS)
+		stream_end_chunk(s);
+	return ret;
+}
+
+/* Check the CRC32 of all image data up to this chunk. */
+static backend_ret_t stream_crc32(struct backend_stream *s)
+{
+	uint32_t crc;
+
+	memcpy(&crc, s->stage, sizeof(crc));
+	s->stage_len = 0;
+
+	if (crc != s->crc) {
+		BE_LOG("CRC32 mismatch: expected %x, got %x\n", crc, s->crc);
+		return BE_CHECKSUM_ERR;
+	}
+
+	stream_end_chunk(s);
+	return BE_SUCCESS;
+}
+
+backend_ret_t backend_stream_write(struct backend_stream *s, const void *data,
+				   uint64_t len)
+{
+	const uint8_t *buff = data;
+
+	while ((len != 0) && (s->ret == BE_SUCCESS)) {
+		switch (s->state) {
+		case STREAM_IMG_HDR:
+			if (stream_stage(s, sizeof(s->img_hdr), &buff, &len))
+				s->ret = stream_start_image(s);
+			break;
+		case STREAM_CHUNK_HDR:
+			if (stream_stage(s, sizeof(s->chunk_hdr), &buff, &len))
+				s->ret = stream_start_chunk(s);
+			break;
+		case STREAM_RAW:
+			s->ret = stream_raw(s, &buff, &len);
+			break;
+		case STREAM_FILL:
+			if (stream_stage(s, sizeof(uint32_t), &buff, &len))
+				s->ret = stream_fill(s);
+			break;
+		case STREAM_CRC32:
+			if (stream_stage(s, sizeof(uint32_t), &buff, &len))
+				s->ret = stream_crc32(s);
+			break;
+		case STREAM_DONE:
+			/* Ignore any data past the end of the image. */
+			len = 0;
+			break;
+		}
+	}
+
+	return s->ret;
+}
+
 /********************** Image Partition handling ******************************/
 
 struct part_info *get_part_info(const char *name)
@@ -594,11 +855,12 @@ static backend_ret_t fill_img_part_info(struct image_part_details *img,
 
 /********************** Backend API functions *******************************/
 
-backend_ret_t backend_write_partition(const char *name, void *image_addr,
-				      uint64_t image_size)
+backend_ret_t backend_stream_open(struct backend_stream **stream,
+				  const char *name, uint64_t image_size)
 {
 	backend_ret_t ret;
 	struct image_part_details img;
+	struct backend_stream *s;
 
 	ret = backend_do_init();
 	if (ret != BE_SUCCESS)
@@ -609,17 +871,70 @@ backend_ret_t backend_write_partition(const char *name, void *image_addr,
 	if (ret != BE_SUCCESS)
 		return ret;
 
-	if (is_sparse_image(image_addr)) {
-		BE_LOG("Writing sparse image to %s...\n", name);
-		ret = write_sparse_image(&img, image_addr, image_size);
-	} else {
-		BE_LOG("Writing raw image to %s...\n", name);
-		ret = write_raw_image(&img, image_addr, image_size);
+	BE_LOG("Streaming image to %s...\n", name);
+
+	s = xzalloc(sizeof(*s));
+	s->ops = &img.bdev_entry->bdev->ops;
+	s->block_size = img.bdev_entry->bdev->block_size;
+	s->discard = CONFIG_FASTBOOT_SPARSE_DISCARD &&
+		(s->ops->erase != NULL) &&
+		(img.bdev_entry->bdev->caps & BLOCKDEV_CAP_DISCARD);
+	s->image_size = image_size;
+	s->part_addr = img.part_addr;
+	s->part_size_lba = img.part_size_lba;
+	s->stage = xmalloc(MAX(s->block_size,
+			       sizeof(struct sparse_image_hdr)));
+	s->merge_max_lba = STREAM_MERGE_SIZE / s->block_size;
+	s->merge = xmalloc(s->merge_max_lba * s->block_size);
+
+	/* Too small to be sparse, treat as raw right away. */
+	if (image_size < sizeof(struct sparse_image_hdr))
+		s->ret = stream_start_raw_image(s);
+
+	*stream = s;
+	return BE_SUCCESS;
+}
+
+backend_ret_t backend_stream_close(struct backend_stream *s)
+{
+	backend_ret_t ret = s->ret;
+
+	if ((ret == BE_SUCCESS) && (s->state != STREAM_DONE))
+		ret = BE_IMAGE_INSUFFICIENT_DATA;
+
+	/* A zero image checksum means the host did not provide one. */
+	if ((ret == BE_SUCCESS) && s->sparse && s->img_hdr.image_checksum &&
+	    (s->img_hdr.image_checksum != s->crc)) {
+		BE_LOG("Image CRC32 mismatch: expected %x, got %x\n",
+		       s->img_hdr.image_checksum, s->crc);
+		ret = BE_CHECKSUM_ERR;
 	}
 
+	if (ret == BE_SUCCESS)
+		ret = stream_flush(s);
+
+	free(s->merge);
+	free(s->stage);
+	free(s);
+
 	return ret;
 }
 
+backend_ret_t backend_write_partition(const char *name, void *image_addr,
+				      uint64_t image_size)
+{
+	backend_ret_t ret;
+	struct backend_stream *stream;
+
+	ret = backend_stream_open(&stream, name, image_size);
+	if (ret != BE_SUCCESS)
+		return ret;
+
+	backend_stream_write(stream, image_addr, image_size);
+
+	return backend_stream_close(stream);
+}
+
 backend_ret_t backend_erase_partition(const char *name)
 {
 	backend_ret_t ret;
@@ -38,6 +38,7 @@ typedef enum {
 	BE_CHUNK_HDR_ERR,
 	BE_GPT_ERR,
 	BE_INVALID_SLOT_INDEX,
+	BE_CHECKSUM_ERR,
 	BE_NOT_HANDLED,
 } backend_ret_t;
 
@@ -110,9 +111,28 @@ extern struct part_base_info *fb_base_list;
 
 backend_ret_t board_write_partition(const char *name, void *image_addr,
 				    uint64_t image_size);
+/*
+ * Returns 0 if the board needs to see the whole image before writing the
+ * partition, e.g. because board_write_partition handles it.
+ */
+int board_can_stream_partition(const char *name);
 backend_ret_t backend_erase_partition(const char *name);
 backend_ret_t backend_write_partition(const char *name, void *image_addr,
 				      uint64_t image_size);
+
+/*
+ * Streaming interface for writing an image to a partition while it is still
+ * being received. Data can be passed to backend_stream_write in pieces of any
+ * size. The first error encountered is returned by all subsequent calls, and
+ * backend_stream_close reports whether the complete image was written.
+ */
+struct backend_stream;
+backend_ret_t backend_stream_open(struct backend_stream **stream,
+				  const char *name, uint64_t image_size);
+backend_ret_t backend_stream_write(struct backend_stream *stream,
+				   const void *data, uint64_t len);
+backend_ret_t backend_stream_close(struct backend_stream *stream);
+
 uint64_t backend_get_part_size_bytes(const char *name);
 const char *backend_get_part_fs_type(const char *name);
 uint64_t backend_get_bdev_size_bytes(const char *name);
@@ -53,6 +53,15 @@ fb_callback_t __attribute__((weak)) fb_board_handler;
 /* Size of currently loaded image (0 = no image loaded). */
 static uint64_t image_size = 0;
 
+/*
+ * Partition selected with "oem Stream-flash". While set, downloads are written
+ * to this partition as they are received instead of being staged in memory,
+ * and the following "flash" only reports the result.
+ */
+static char *stream_part;
+/* Set once a streamed download has been written, cleared by "flash". */
+static int stream_written;
+
 static void fb_print_on_screen(fb_msg_t type, const char *msg)
 {
 	if (fb_board_handler.print_screen)
@@ -902,33 +911,173 @@ static fb_ret_type fb_getvar(struct fb_cmd *cmd)
 	}
 }
 
+const char *backend_error_string[] = {
+	[BE_PART_NOT_FOUND] = "partition not found",
+	[BE_BDEV_NOT_FOUND] = "block device not found",
+	[BE_IMAGE_SIZE_MULTIPLE_ERR] = "image not multiple of block size",
+	[BE_IMAGE_OVERFLOW_ERR] = "image greater than partition size",
+	[BE_IMAGE_INSUFFICIENT_DATA] = "image does not have enough data",
+	[BE_WRITE_ERR] = "image write failed",
+	[BE_SPARSE_HDR_ERR] = "sparse header error",
+	[BE_CHUNK_HDR_ERR] = "sparse chunk header error",
+	[BE_GPT_ERR] = "GPT error",
+	[BE_INVALID_SLOT_INDEX] = "Invalid slot index",
+	[BE_CHECKSUM_ERR] = "image checksum mismatch",
+};
+
 /*
- * Func: fb_recv_data
- * Desc: Download data from host
- *
+ * Func: fb_recv_pipelined
+ * Desc: Download image_size bytes from host, passing each received piece to
+ * consume(). FB_RECV_BUFS buffers are kept queued on the OUT endpoint so that
+ * the controller keeps receiving while consume() runs. On a consume() error
+ * the remaining data is still drained to keep the protocol in sync.
  */
-static int fb_recv_data(struct fb_cmd *cmd)
+#define FB_RECV_BUFS		2
+#define FB_RECV_BUF_SIZE	(4 * CONFIG_FASTBOOT_USB_XFER_SIZE)
+
+static uint64_t fb_recv_pipelined(struct fb_cmd *cmd,
+				  void (*consume)(void *ctx, const void *data,
+						  size_t len),
+				  void *ctx)
 {
 	uint64_t curr_len = 0;
+	uint64_t queued = 0;
+	void *buff[FB_RECV_BUFS];
+	size_t size[FB_RECV_BUFS];
+	int nbufs;
+	int i;
 
-	while (curr_len < image_size) {
-		void *curr = (uint8_t *)fb_get_image_ptr() + curr_len;
+	for (i = 0; i < FB_RECV_BUFS; i++)
+		buff[i] = usb_gadget_alloc_data(FB_RECV_BUF_SIZE);
+
+	for (i = 0; (i < FB_RECV_BUFS) && (queued < image_size); i++) {
+		size[i] = MIN(image_size - queued, FB_RECV_BUF_SIZE);
+		queued += usb_gadget_recv_start(buff[i], size[i]);
+	}
 
-		uint64_t ret = usb_gadget_recv(curr, image_size - curr_len);
+	/* Buffers are requeued at the tail, so they complete round-robin. */
+	nbufs = i;
+	i = 0;
+	while (curr_len < image_size) {
+		size_t ret = usb_gadget_recv_wait();
 
 		if (ret == 0) {
 			curr_len = 0;
 			cmd->type = FB_NONE;
-			return curr_len;
+			break;
 		}
 
 		curr_len += ret;
+		/* Host may have ended the transfer early. */
+		queued -= size[i] - ret;
+		consume(ctx, buff[i], ret);
+
+		/* Reuse the buffer for the next part of the image. */
+		if (queued < image_size) {
+			size[i] = MIN(image_size - queued, FB_RECV_BUF_SIZE);
+			queued += usb_gadget_recv_start(buff[i], size[i]);
+		}
+
+		i = (i + 1) % nbufs;
 	}
 
-	cmd->type = FB_OKAY;
+	for (i = 0; i < FB_RECV_BUFS; i++)
+		usb_gadget_free_data(buff[i]);
+
+	if (curr_len)
+		cmd->type = FB_OKAY;
 	return curr_len;
 }
 
+static void fb_recv_to_memory(void *ctx, const void *data, size_t len)
+{
+	uint64_t *offset = ctx;
+
+	memcpy((uint8_t *)fb_get_image_ptr() + *offset, data, len);
+	*offset += len;
+}
+
+/*
+ * Func: fb_recv_data
+ * Desc: Download data from host
+ *
+ */
+static int fb_recv_data(struct fb_cmd *cmd)
+{
+	uint64_t offset = 0;
+
+	return fb_recv_pipelined(cmd, fb_recv_to_memory, &offset) != 0;
+}
+
+static void fb_recv_to_stream(void *ctx, const void *data, size_t len)
+{
+	backend_stream_write(ctx, data, len);
+}
+
+/*
+ * Func: fb_stream_recv_data
+ * Desc: Download data from host and write it to the stream partition on the
+ * fly, while the following data is still being received.
+ */
+static int fb_stream_recv_data(struct fb_cmd *cmd,
+			       struct backend_stream *stream)
+{
+	return fb_recv_pipelined(cmd, fb_recv_to_stream, stream) != 0;
+}
+
+/*
+ * Func: fb_stream_download
+ * Desc: Receive image from host and write it directly to the stream partition.
+ * Image size is not limited by the memory available for downloads.
+ */
+static fb_ret_type fb_stream_download(struct fb_cmd *cmd)
+{
+	struct fb_buffer *output = &cmd->output;
+	struct backend_stream *stream;
+	backend_ret_t ret;
+
+	/* No guarantees if battery state changes during flash operation. */
+	if (!battery_soc_check()) {
+		FB_LOG("Battery state-of-charge not acceptable.\n");
+		fb_add_string(output, "battery state-of-charge not acceptable",
+			      NULL);
+		image_size = 0;
+		return FB_SUCCESS;
+	}
+
+	fb_print_on_screen(PRINT_WARN, "Writing flash....\n");
+
+	ret = backend_stream_open(&stream, stream_part, image_size);
+	if (ret != BE_SUCCESS) {
+		fb_add_string(output, backend_error_string[ret], NULL);
+		image_size = 0;
+		return FB_SUCCESS;
+	}
+
+	cmd->type = FB_DATA;
+	fb_add_number(output, "%08llx", image_size);
+	fb_execute_send(cmd);
+
+	if (fb_stream_recv_data(cmd, stream) == 0)
+		FB_LOG("Failed to download data\n");
+
+	ret = backend_stream_close(stream);
+
+	/* Nothing usable is left in the download buffer. */
+	image_size = 0;
+
+	if (cmd->type == FB_NONE)
+		return FB_SUCCESS;
+
+	if (ret != BE_SUCCESS) {
+		cmd->type = FB_FAIL;
+		fb_add_string(output, backend_error_string[ret], NULL);
+	} else
+		stream_written = 1;
+
+	return FB_SUCCESS;
+}
+
 /*
  * Func: fb_download
  * Desc: Allocate space for downloading image and receive image from host.
@@ -954,6 +1103,11 @@ static fb_ret_type fb_download(struct fb_cmd *cmd)
 
 	fb_free_string(num);
 
+	stream_written = 0;
+
+	if (stream_part)
+		return fb_stream_download(cmd);
+
 	if (image_size > fb_get_max_download_size()) {
 		fb_add_string(output, "not sufficient memory", NULL);
 		image_size = 0;
@@ -981,19 +1135,6 @@ static fb_ret_type fb_verify(struct fb_cmd *cmd)
 	return FB_SUCCESS;
 }
 
-const char *backend_error_string[] = {
-	[BE_PART_NOT_FOUND] = "partition not found",
-	[BE_BDEV_NOT_FOUND] = "block device not found",
-	[BE_IMAGE_SIZE_MULTIPLE_ERR] = "image not multiple of block size",
-	[BE_IMAGE_OVERFLOW_ERR] = "image greater than partition size",
-	[BE_IMAGE_INSUFFICIENT_DATA] = "image does not have enough data",
-	[BE_WRITE_ERR] = "image write failed",
-	[BE_SPARSE_HDR_ERR] = "sparse header error",
-	[BE_CHUNK_HDR_ERR] = "sparse chunk header error",
-	[BE_GPT_ERR] = "GPT error",
-	[BE_INVALID_SLOT_INDEX] = "Invalid slot index",
-};
-
 static fb_ret_type fb_erase(struct fb_cmd *cmd)
 {
 	/* No guarantees if battery state changes during erase operation. */
@@ -1056,6 +1197,17 @@ static fb_ret_type fb_flash(struct fb_cmd *cmd)
 	}
 
 	backend_ret_t ret;
+	struct fb_buffer *input = &cmd->input;
+	size_t len = fb_buffer_length(input);
+	char *data = fb_buffer_pull(input, len);
+
+	/* Streamed download was already written to the partition. */
+	if (stream_written && (strlen(stream_part) == len) &&
+	    !memcmp(stream_part, data, len)) {
+		stream_written = 0;
+		cmd->type = FB_OKAY;
+		return FB_SUCCESS;
+	}
 
 	if (image_size == 0) {
 		fb_add_string(&cmd->output, "no image downloaded", NULL);
@@ -1069,10 +1221,6 @@ static fb_ret_type fb_flash(struct fb_cmd *cmd)
 	fb_execute_send(cmd);
 	fb_print_on_screen(PRINT_WARN, "Writing flash....\n");
 
-	struct fb_buffer *input = &cmd->input;
-	size_t len = fb_buffer_length(input);
-	char *data = fb_buffer_pull(input, len);
-
 	cmd->type = FB_OKAY;
 
 	char *partition = fb_get_string(data, len);
@@ -1453,6 +1601,54 @@ static fb_ret_type fb_set_off_mode_charge(struct fb_cmd *cmd)
 	return FB_SUCCESS;
 }
 
+/*
+ * Select partition to be written by subsequent downloads as they are being
+ * received ("oem Stream-flash <partition>"), or go back to staging downloads in
+ * memory ("oem Stream-flash off").
+ */
+static fb_ret_type fb_stream_flash(struct fb_cmd *cmd)
+{
+	struct fb_buffer *input = &cmd->input;
+	size_t len = fb_buffer_length(input);
+	char *data = fb_buffer_pull(input, len);
+
+	/* No guarantees if battery state changes during flash operation. */
+	if (!battery_soc_check()) {
+		FB_LOG("Battery state-of-charge not acceptable.\n");
+		cmd->type = FB_FAIL;
+		fb_add_string(&cmd->output,
+			      "battery state-of-charge not acceptable", NULL);
+		return FB_SUCCESS;
+	}
+
+	fb_free_string(stream_part);
+	stream_part = NULL;
+	stream_written = 0;
+
+	cmd->type = FB_OKAY;
+
+	if ((len == strlen("off")) && !memcmp(data, "off", len))
+		return FB_SUCCESS;
+
+	stream_part = fb_get_string(data, len);
+
+	if (backend_get_part_size_bytes(stream_part) == 0) {
+		fb_free_string(stream_part);
+		stream_part = NULL;
+		cmd->type = FB_FAIL;
+		fb_add_string(&cmd->output,
+			      backend_error_string[BE_PART_NOT_FOUND], NULL);
+	} else if (!board_can_stream_partition(stream_part)) {
+		fb_free_string(stream_part);
+		stream_part = NULL;
+		cmd->type = FB_FAIL;
+		fb_add_string(&cmd->output, "partition can't be streamed",
+			      NULL);
+	}
+
+	return FB_SUCCESS;
+}
+
 static fb_ret_type fb_clear_gbb(struct fb_cmd *cmd)
 {
 	if (gbb_clear_flags() == 0) {
@@ -1539,6 +1735,7 @@ const struct fastboot_func fb_func_table[] = {
 	{ NAME_NO_ARGS("oem Battery-cutoff"), FB_ID_BATTERY_CUTOFF,
 	  fb_battery_cutoff},
 	{ NAME_ARGS("oem Setenv", ' '), FB_ID_SETENV, fb_setenv},
+	{ NAME_ARGS("oem Stream-flash", ' '), FB_ID_FLASH, fb_stream_flash},
 	{ NAME_NO_ARGS("oem Clear-gbb"), FB_ID_CLEAR_GBB, fb_clear_gbb},
 	{ NAME_NO_ARGS("oem Write-protect"), FB_ID_WRITE_PROTECT,
 	  fb_write_protect},
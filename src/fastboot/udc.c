@@ -34,11 +34,55 @@ static device_descriptor_t device_descriptor = {
 	.idProduct = CONFIG_FASTBOOT_USBPID,
 };
 
-/* Length of OUT transfer. Because these transfers
- * are named from the host's point of view, OUT
- * is "receive" for us.
+/*
+ * Receive requests queued on the OUT endpoint. Because these transfers are
+ * named from the host's point of view, OUT is "receive" for us. Each request
+ * is split into transfers of at most CONFIG_FASTBOOT_USB_XFER_SIZE bytes which
+ * are all handed to the controller at once. The controller completes them in
+ * order, so completions are always accounted to the oldest request.
  */
-static int out_length;
+#define MAX_RECV_REQS		8
+
+_Static_assert(CONFIG_FASTBOOT_USB_XFER_SIZE &&
+	       !(CONFIG_FASTBOOT_USB_XFER_SIZE &
+		 (CONFIG_FASTBOOT_USB_XFER_SIZE - 1)),
+	       "FASTBOOT_USB_XFER_SIZE must be a power of two");
+
+struct recv_req {
+	uint8_t *buff;
+	/* Number of transfers queued and completed */
+	size_t xfers;
+	size_t done;
+	/* Number of bytes received */
+	size_t length;
+};
+
+static struct recv_req recv_reqs[MAX_RECV_REQS];
+/* Index of oldest request and number of requests queued */
+static int recv_head;
+static int recv_count;
+
+static void fastboot_recv_complete(void *data, int len)
+{
+	int i;
+	struct recv_req *req;
+
+	for (i = 0; i < recv_count; i++) {
+		req = &recv_reqs[(recv_head + i) % MAX_RECV_REQS];
+		if (req->done < req->xfers)
+			break;
+	}
+
+	if (i == recv_count)
+		return;
+
+	/* Keep data contiguous if an earlier transfer came up short. */
+	if (req->buff + req->length != data)
+		memmove(req->buff + req->length, data, len);
+
+	req->length += len;
+	req->done++;
+}
 
 static void fastboot_packet(struct usbdev_ctrl *this, int ep, int in_dir,
 	void *data, int len)
@@ -48,8 +92,8 @@ static void fastboot_packet(struct usbdev_ctrl *this, int ep, int in_dir,
 	if (!in_dir && (ep != CONFIG_FASTBOOT_EP_OUT)) return;
 
 	if (in_dir == 0) {
-		// tell usb_gadget_recv() that the transfer is done
-		out_length = len;
+		// tell usb_gadget_recv_wait() that the transfer is done
+		fastboot_recv_complete(data, len);
 	}
 }
 
@@ -82,7 +126,7 @@ static struct usbdev_configuration fastboot_config = {
 			.bDescriptorType = 5,
 			.bEndpointAddress = CONFIG_FASTBOOT_EP_OUT,
 			.bmAttributes = 2, // Bulk
-			.wMaxPacketSize = 512,
+			.wMaxPacketSize = CONFIG_FASTBOOT_EP_MAX_PACKET,
 			.bInterval = 9,
 		},
 		{
@@ -90,7 +134,7 @@ static struct usbdev_configuration fastboot_config = {
 			.bDescriptorType = 5,
 			.bEndpointAddress = 0x80 | CONFIG_FASTBOOT_EP_IN,
 			.bmAttributes = 2, // Bulk
-			.wMaxPacketSize = 512,
+			.wMaxPacketSize = CONFIG_FASTBOOT_EP_MAX_PACKET,
 			.bInterval = 9,
 		}},
 		.init = NULL,
@@ -170,46 +214,97 @@ static void usb_gadget_force_shutdown(void)
 	udc->force_shutdown(udc);
 }
 
-size_t usb_gadget_recv(void *pkt, size_t size)
+void *usb_gadget_alloc_data(size_t size)
 {
-	/* max 64 packets at once */
-	const uint32_t blocksize = 64 * 512;
-	size_t total = 0;
-	size_t remaining = size;
-	if (size > blocksize)
-		size = blocksize;
+	return udc->alloc_data(size);
+}
 
-	void *tmp = udc->alloc_data(size);
+void usb_gadget_free_data(void *ptr)
+{
+	udc->free_data(ptr);
+}
+
+size_t usb_gadget_recv_start(void *pkt, size_t size)
+{
+	struct recv_req *req;
+	size_t offset;
+
+	if (recv_count == MAX_RECV_REQS)
+		return 0;
 
 	/* wait until the device is ready */
 	while (!udc->initialized)
 		udc->poll(udc);
 
+	req = &recv_reqs[(recv_head + recv_count) % MAX_RECV_REQS];
+	req->buff = pkt;
+	req->xfers = ALIGN_UP(size, CONFIG_FASTBOOT_USB_XFER_SIZE) /
+		CONFIG_FASTBOOT_USB_XFER_SIZE;
+	req->done = 0;
+	req->length = 0;
+	recv_count++;
+
+	for (offset = 0; offset < size;
+	     offset += CONFIG_FASTBOOT_USB_XFER_SIZE)
+		udc->enqueue_packet(udc, CONFIG_FASTBOOT_EP_OUT, 0,
+				    req->buff + offset,
+				    MIN(size - offset,
+					CONFIG_FASTBOOT_USB_XFER_SIZE), 0, 0);
+
+	return size;
+}
+
+size_t usb_gadget_recv_wait(void)
+{
+	struct recv_req *req = &recv_reqs[recv_head];
+
+	if (recv_count == 0)
+		return 0;
+
+	while ((req->done < req->xfers) && udc->initialized)
+		udc->poll(udc);
+
+	/* If lost connection, re-initialize gadget mode. */
+	if (!udc->initialized) {
+		recv_count = 0;
+		usb_gadget_force_shutdown();
+		usb_gadget_init();
+		return 0;
+	}
+
+	recv_head = (recv_head + 1) % MAX_RECV_REQS;
+	recv_count--;
+
+	return req->length;
+}
+
+size_t usb_gadget_recv(void *pkt, size_t size)
+{
+	size_t total = 0;
+	size_t remaining = size;
+	size_t length;
+	if (size > CONFIG_FASTBOOT_USB_XFER_SIZE)
+		size = CONFIG_FASTBOOT_USB_XFER_SIZE;
+
+	void *tmp = udc->alloc_data(size);
+
 	while (remaining != 0) {
-		out_length = 0;
 		if (size > remaining)
 			size = remaining;
 
-		udc->enqueue_packet(udc, CONFIG_FASTBOOT_EP_OUT, 0,
-			tmp, size, 0, 0);
-		while ((out_length == 0) && udc->initialized)
-			udc->poll(udc);
-
-		/* If lost connection, re-initialize gadget mode. */
-		if (!udc->initialized) {
-			usb_gadget_force_shutdown();
-			usb_gadget_init();
+		usb_gadget_recv_start(tmp, size);
+		length = usb_gadget_recv_wait();
+		if (length == 0)
 			return 0;
-		}
 
-		memcpy(pkt, tmp, out_length);
+		memcpy(pkt, tmp, length);
 
-		total += out_length;
-		remaining -= out_length;
-		pkt += out_length;
+		total += length;
+		remaining -= length;
+		pkt += length;
 
 		/* short transfer should only happen at the end */
-		if (out_length < size)
+		if (length < size)
 			break;
 	}
 	udc->free_data(tmp);
@@ -26,6 +26,20 @@ int usb_gadget_init(void);
 size_t usb_gadget_send(const char *msg, size_t size);
 /* Recv a pack from host using gadget driver. Returns number of bytes rcvd */
 size_t usb_gadget_recv(void *pkt, size_t size);
+/*
+ * Queue a receive of size bytes directly into pkt, which must have been
+ * allocated with usb_gadget_alloc_data(). Several receives can be queued; they
+ * proceed in the background and complete in order through
+ * usb_gadget_recv_wait(). Since queued transfers cannot be cancelled, callers
+ * must not queue more data than the host is going to send. Returns number of
+ * bytes queued, 0 if too many receives are already queued.
+ */
+size_t usb_gadget_recv_start(void *pkt, size_t size);
+/* Wait for the oldest queued receive to finish. Returns number of bytes rcvd */
+size_t usb_gadget_recv_wait(void);
+/* Allocate / free buffers that the gadget driver can transfer into. */
+void *usb_gadget_alloc_data(size_t size);
+void usb_gadget_free_data(void *ptr);
 /* Clean up the gadget driver. */
 void usb_gadget_stop(void);
 
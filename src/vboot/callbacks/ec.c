@@ -27,6 +27,7 @@
 #include "config.h"
 #include "drivers/ec/cros/ec.h"
 #include "drivers/ec/vboot_aux_fw.h"
+#include "drivers/ec/vboot_ec.h"
 #include "drivers/flash/flash.h"
 #include "drivers/flash/cbfs.h"
 #include "image/fmap.h"
@@ -40,7 +41,26 @@
 
 static struct cbfs_media *ro_cbfs;
 
-static void *get_file_from_cbfs(
+enum {
+	EcFileImage,
+	EcFileHash,
+	EcFileTypes
+};
+
+/*
+ * The files last handed to vboot for each EC. They stay mapped until vboot
+ * asks for the same kind of file again, the image has been written to the
+ * EC, or software sync is done.
+ */
+static const void *ec_mapped_files[NUM_MAX_VBOOT_ECS][EcFileTypes];
+
+static void ec_unmap_file(int devidx, int type)
+{
+	cbfs_index_unmap_file(ec_mapped_files[devidx][type]);
+	ec_mapped_files[devidx][type] = NULL;
+}
+
+static const void *get_file_from_cbfs(
 	const char *filename, enum VbSelectFirmware_t select, size_t *size)
 {
 	if (!IS_ENABLED(CONFIG_DRIVER_CBFS_FLASH))
@@ -50,13 +70,13 @@ static void *get_file_from_cbfs(
 		printf("Trying to locate '%s' in RO CBFS\n", filename);
 		if (ro_cbfs == NULL)
 			ro_cbfs = cbfs_ro_media();
-		return cbfs_get_file_content(ro_cbfs, filename,
-					     CBFS_TYPE_RAW, size);
+		return cbfs_index_map_file(ro_cbfs, filename,
+					   CBFS_TYPE_RAW, size);
 	}
 
 	printf("Trying to locate '%s' in CBFS\n", filename);
-	return cbfs_get_file_content(CBFS_DEFAULT_MEDIA, filename,
-				     CBFS_TYPE_RAW, size);
+	return cbfs_index_map_file(CBFS_DEFAULT_MEDIA, filename,
+				   CBFS_TYPE_RAW, size);
 }
 
 int VbExTrustEC(int devidx)
@@ -109,7 +129,9 @@ VbError_t VbExEcGetExpectedImage(int devidx, enum VbSelectFirmware_t select,
 {
 	size_t size;
 	const char *filename = EC_IMAGE_FILENAME(devidx, select);
+	ec_unmap_file(devidx, EcFileImage);
 	*image = get_file_from_cbfs(filename, select, &size);
+	ec_mapped_files[devidx][EcFileImage] = *image;
 	if (*image == NULL)
 		return VBERROR_UNKNOWN;
 	*image_size = size;
@@ -121,7 +143,9 @@ VbError_t VbExEcGetExpectedImageHash(int devidx, enum VbSelectFirmware_t select,
 {
 	size_t size;
 	const char *filename = EC_HASH_FILENAME(devidx, select);
+	ec_unmap_file(devidx, EcFileHash);
 	*hash = get_file_from_cbfs(filename, select, &size);
+	ec_mapped_files[devidx][EcFileHash] = *hash;
 	if (!*hash)
 		return VBERROR_UNKNOWN;
 	*hash_size = size;
@@ -133,8 +157,13 @@ VbError_t VbExEcUpdateImage(int devidx, enum VbSelectFirmware_t select,
 			    const uint8_t *image, int image_size)
 {
 	VbootEcOps *ec = vboot_ec[devidx];
+	VbError_t ret;
+
 	assert(ec && ec->update_image);
-	return ec->update_image(ec, select, image, image_size);
+	ret = ec->update_image(ec, select, image, image_size);
+	if (image == ec_mapped_files[devidx][EcFileImage])
+		ec_unmap_file(devidx, EcFileImage);
+	return ret;
 }
 
 VbError_t VbExEcProtect(int devidx, enum VbSelectFirmware_t select)
@@ -162,6 +191,11 @@ VbError_t VbExEcVbootDone(int in_recovery)
 	int limit_power_wait_time = 0;
 	int message_printed = 0;
 
+	/* Software sync is done with the images and hashes. */
+	for (int devidx = 0; devidx < NUM_MAX_VBOOT_ECS; devidx++)
+		for (int type = 0; type < EcFileTypes; type++)
+			ec_unmap_file(devidx, type);
+
 	/* Ensure we have enough power to continue booting */
 	while(1) {
 		if (cros_ec_read_limit_power_request(&limit_power)) {
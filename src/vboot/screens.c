@@ -68,8 +68,15 @@
 static char initialized = 0;
 static int  prev_lang_page_num = -1;
 static int  prev_selected_index = -1;
-static struct directory *base_graphics;
-static struct directory *font_graphics;
+static const struct directory *base_graphics;
+static const struct directory *font_graphics;
+static struct {
+	/* font.bin entry for each character code */
+	const struct dentry *files[256];
+	/* glyph widths at the given height, 0 if not computed yet */
+	int32_t widths[256];
+	int32_t height;
+} font_glyphs;
 static struct cbfs_media *ro_cbfs;
 static struct {
 	/* current locale */
@@ -77,13 +84,21 @@ static struct {
 
 	/* pointer to the localized graphics data and its locale */
 	uint32_t archive_locale;
-	struct directory *archive;
+	const struct directory *archive;
 
 	/* number of supported language and codes: en, ja, ... */
 	uint32_t count;
 	char *codes[256];
 } locale_data;
 
+/* menu currently on screen, used to only redraw entries that changed */
+static struct {
+	const char *const *strings;
+	uint32_t locale;
+	uint32_t selected_index;
+	uint32_t disabled_idx_mask;
+} drawn_menu;
+
 /* params structure for vboot draw functions */
 struct params {
 	uint32_t locale;
@@ -99,57 +114,60 @@ struct menu {
 };
 
 /*
- * Load archive into RAM
+ * Offset of the first file in an archive. Archives are mapped read-only
+ * straight from CBFS, so header fields are converted on every access.
+ */
+static uint32_t archive_first_offset(const struct directory *dir)
+{
+	return sizeof(*dir) + le32toh(dir->count) * sizeof(struct dentry);
+}
+
+/*
+ * Map archive from CBFS
  */
-static VbError_t load_archive(const char *name, struct directory **dest)
+static VbError_t load_archive(const char *name,
+			      const struct directory **dest)
 {
-	struct directory *dir;
-	struct dentry *entry;
+	const struct directory *dir;
 	size_t size;
-	int i;
 
 	printf("%s: loading %s\n", __func__, name);
 	*dest = NULL;
 
-	/* load archive from cbfs */
-	dir = cbfs_get_file_content(ro_cbfs, name, CBFS_TYPE_RAW, &size);
+	/* map archive from cbfs */
+	dir = cbfs_index_map_file(ro_cbfs, name, CBFS_TYPE_RAW, &size);
 	if (!dir || !size) {
 		printf("%s: failed to load %s\n", __func__, name);
+		cbfs_index_unmap_file(dir);
 		return VBERROR_INVALID_BMPFV;
 	}
 
-	/* convert endianness of archive header */
-	dir->count = le32toh(dir->count);
-	dir->size = le32toh(dir->size);
-
 	/* validate the total size */
-	if (dir->size != size) {
+	if (size < sizeof(*dir) || le32toh(dir->size) != size) {
 		printf("%s: archive size does not match\n", __func__);
-		return VBERROR_INVALID_BMPFV;
+		goto invalid;
 	}
 
 	/* validate magic field */
 	if (memcmp(dir->magic, CBAR_MAGIC, sizeof(CBAR_MAGIC))) {
 		printf("%s: invalid archive magic\n", __func__);
-		return VBERROR_INVALID_BMPFV;
+		goto invalid;
 	}
 
 	/* validate count field */
-	if (get_first_offset(dir) > dir->size) {
+	if (le32toh(dir->count) > size ||
+	    archive_first_offset(dir) > size) {
 		printf("%s: invalid count\n", __func__);
-		return VBERROR_INVALID_BMPFV;
-	}
-
-	/* convert endianness of file headers */
-	entry = get_first_dentry(dir);
-	for (i = 0; i < dir->count; i++) {
-		entry[i].offset = le32toh(entry[i].offset);
-		entry[i].size = le32toh(entry[i].size);
+		goto invalid;
 	}
 
 	*dest = dir;
 
 	return VBERROR_SUCCESS;
+
+invalid:
+	cbfs_index_unmap_file(dir);
+	return VBERROR_INVALID_BMPFV;
 }
 
 static VbError_t load_localized_graphics(uint32_t locale)
@@ -161,7 +179,7 @@ static VbError_t load_localized_graphics(uint32_t locale)
 		if (locale_data.archive_locale == locale)
 			return VBERROR_SUCCESS;
 		/* No need to keep more than one locale graphics at a time */
-		free(locale_data.archive);
+		cbfs_index_unmap_file(locale_data.archive);
 	}
 
 	/* compose archive name using the language code */
@@ -174,11 +192,25 @@ static VbError_t load_localized_graphics(uint32_t locale)
 	return VBERROR_SUCCESS;
 }
 
-static struct dentry *find_file_in_archive(const struct directory *dir,
-					   const char *name)
+/* Check that a file lies within the content section of its archive */
+static int dentry_is_valid(const struct directory *dir,
+			   const struct dentry *entry)
+{
+	uint32_t start = archive_first_offset(dir);
+	uint32_t dir_size = le32toh(dir->size);
+	uint32_t offset = le32toh(entry->offset);
+	uint32_t size = le32toh(entry->size);
+
+	return !(offset < start
+			|| offset + size > dir_size
+			|| offset > dir_size
+			|| size > dir_size);
+}
+
+static const struct dentry *find_file_in_archive(
+	const struct directory *dir, const char *name)
 {
-	struct dentry *entry;
-	uintptr_t start;
+	const struct dentry *entry;
 	int i;
 
 	if (!dir) {
@@ -186,17 +218,11 @@ static struct dentry *find_file_in_archive(const struct directory *dir,
 		return NULL;
 	}
 
-	/* calculate start of the file content section */
-	start = get_first_offset(dir);
 	entry = get_first_dentry(dir);
-	for (i = 0; i < dir->count; i++) {
-		if (strncmp(entry[i].name, name, NAME_LENGTH))
+	for (i = 0; i < le32toh(dir->count); i++) {
+		if (strncmp((const char *)entry[i].name, name, NAME_LENGTH))
 			continue;
-		/* validate offset & size */
-		if (entry[i].offset < start
-				|| entry[i].offset + entry[i].size > dir->size
-				|| entry[i].offset > dir->size
-				|| entry[i].size > dir->size) {
+		if (!dentry_is_valid(dir, &entry[i])) {
 			printf("%s: '%s' has invalid offset or size\n",
 			       __func__, name);
 			return NULL;
@@ -212,16 +238,11 @@ static struct dentry *find_file_in_archive(const struct directory *dir,
 /*
  * Find and draw image in archive
  */
-static VbError_t draw(struct directory *dir, const char *image_name,
-		      int32_t x, int32_t y, int32_t width, int32_t height,
-		      uint32_t flags)
+static VbError_t draw_file(const struct directory *dir,
+			   const struct dentry *file,
+			   int32_t x, int32_t y, int32_t width, int32_t height,
+			   uint32_t flags)
 {
-	struct dentry *file;
-
-	file = find_file_in_archive(dir, image_name);
-	if (!file)
-		return VBERROR_NO_IMAGE_PRESENT;
-
 	struct scale pos = {
 		.x = { .n = x, .d = VB_SCALE, },
 		.y = { .n = y, .d = VB_SCALE, },
@@ -230,8 +251,21 @@ static VbError_t draw(struct directory *dir, const char *image_name,
 		.x = { .n = width, .d = VB_SCALE, },
 		.y = { .n = height, .d = VB_SCALE, },
 	};
-	return draw_bitmap((uint8_t *)dir + file->offset, file->size,
-			   &pos, &dim, flags);
+	return draw_bitmap((const uint8_t *)dir + le32toh(file->offset),
+			   le32toh(file->size), &pos, &dim, flags);
+}
+
+static VbError_t draw(const struct directory *dir, const char *image_name,
+		      int32_t x, int32_t y, int32_t width, int32_t height,
+		      uint32_t flags)
+{
+	const struct dentry *file;
+
+	file = find_file_in_archive(dir, image_name);
+	if (!file)
+		return VBERROR_NO_IMAGE_PRESENT;
+
+	return draw_file(dir, file, x, y, width, height, flags);
 }
 
 static VbError_t draw_image(const char *image_name,
@@ -258,23 +292,19 @@ static VbError_t draw_image_locale(const char *image_name, uint32_t locale,
 	return rv;
 }
 
-static VbError_t get_image_size(struct directory *dir, const char *image_name,
-				int32_t *width, int32_t *height)
+static VbError_t get_file_size(const struct directory *dir,
+			       const struct dentry *file,
+			       int32_t *width, int32_t *height)
 {
-	struct dentry *file;
 	VbError_t rv;
 
-	file = find_file_in_archive(dir, image_name);
-	if (!file)
-		return VBERROR_NO_IMAGE_PRESENT;
-
 	struct scale dim = {
 		.x = { .n = *width, .d = VB_SCALE, },
 		.y = { .n = *height, .d = VB_SCALE, },
 	};
 
-	rv = get_bitmap_dimension((uint8_t *)dir + file->offset,
-				  file->size, &dim);
+	rv = get_bitmap_dimension((const uint8_t *)dir + le32toh(file->offset),
+				  le32toh(file->size), &dim);
 	if (rv)
 		return VBERROR_UNKNOWN;
 
@@ -284,6 +314,19 @@ static VbError_t get_image_size(struct directory *dir, const char *image_name,
 	return VBERROR_SUCCESS;
 }
 
+static VbError_t get_image_size(const struct directory *dir,
+				const char *image_name,
+				int32_t *width, int32_t *height)
+{
+	const struct dentry *file;
+
+	file = find_file_in_archive(dir, image_name);
+	if (!file)
+		return VBERROR_NO_IMAGE_PRESENT;
+
+	return get_file_size(dir, file, width, height);
+}
+
 static VbError_t get_image_size_locale(const char *image_name, uint32_t locale,
 				       int32_t *width, int32_t *height)
 {
@@ -299,18 +342,69 @@ static int draw_icon(const char *image_name)
 			  PIVOT_H_CENTER|PIVOT_V_BOTTOM);
 }
 
-static int draw_text(const char *text, int32_t x, int32_t y,
-		     int32_t height, char pivot)
+/*
+ * Build the glyph table from font.bin once. Glyphs are stored as
+ * idx<code>_<hex code>.bmp, so the table is indexed by the character code.
+ */
+static void init_font_glyphs(void)
 {
+	const struct dentry *entry;
+	const char *name;
+	int i, code;
+
+	memset(&font_glyphs, 0, sizeof(font_glyphs));
+	if (!font_graphics)
+		return;
+
+	entry = get_first_dentry(font_graphics);
+	for (i = 0; i < le32toh(font_graphics->count); i++) {
+		name = (const char *)entry[i].name;
+		if (strncmp(name, "idx", 3) || !dentry_is_valid(font_graphics,
+								&entry[i]))
+			continue;
+		code = strtol(name + 3, NULL, 10);
+		font_glyphs.files[(uint8_t)code] = &entry[i];
+	}
+}
+
+/* Return the width of a character at the given height, cached per height */
+static VbError_t get_glyph_width(char c, int32_t height, int32_t *width)
+{
+	uint8_t code = c;
 	int32_t w, h;
-	char str[256];
-	while (*text) {
-		sprintf(str, "idx%03d_%02x.bmp", *text, *text);
+
+	if (!font_glyphs.files[code]) {
+		printf("%s: no glyph for character 0x%02x\n", __func__, code);
+		return VBERROR_NO_IMAGE_PRESENT;
+	}
+
+	if (font_glyphs.height != height) {
+		memset(font_glyphs.widths, 0, sizeof(font_glyphs.widths));
+		font_glyphs.height = height;
+	}
+
+	if (!font_glyphs.widths[code]) {
 		w = 0;
 		h = height;
-		RETURN_ON_ERROR(get_image_size(font_graphics, str, &w, &h));
-		RETURN_ON_ERROR(draw(font_graphics, str,
-				     x, y, VB_SIZE_AUTO, height, pivot));
+		RETURN_ON_ERROR(get_file_size(font_graphics,
+					      font_glyphs.files[code],
+					      &w, &h));
+		font_glyphs.widths[code] = w;
+	}
+
+	*width = font_glyphs.widths[code];
+	return VBERROR_SUCCESS;
+}
+
+static int draw_text(const char *text, int32_t x, int32_t y,
+		     int32_t height, char pivot)
+{
+	int32_t w;
+	while (*text) {
+		RETURN_ON_ERROR(get_glyph_width(*text, height, &w));
+		RETURN_ON_ERROR(draw_file(font_graphics,
+					  font_glyphs.files[(uint8_t)*text],
+					  x, y, VB_SIZE_AUTO, height, pivot));
 		x += w;
 		text++;
 	}
@@ -319,13 +413,9 @@ static int draw_text(const char *text, int32_t x, int32_t y,
 
 static int get_text_width(const char *text, int32_t *width, int32_t *height)
 {
-	int32_t w, h;
-	char str[256];
+	int32_t w;
 	while (*text) {
-		sprintf(str, "idx%03d_%02x.bmp", *text, *text);
-		w = 0;
-		h = *height;
-		RETURN_ON_ERROR(get_image_size(font_graphics, str, &w, &h));
+		RETURN_ON_ERROR(get_glyph_width(*text, *height, &w));
 		*width += w;
 		text++;
 	}
@@ -503,6 +593,8 @@ static VbError_t draw_base_screen(uint32_t locale, int show_language)
 {
 	const struct rgb_color white = { 0xff, 0xff, 0xff };
 
+	/* The menu on screen, if any, is about to be wiped */
+	drawn_menu.strings = NULL;
 	if (clear_screen(&white))
 		return VBERROR_UNKNOWN;
 	RETURN_ON_ERROR(draw_image("chrome_logo.bmp",
@@ -540,6 +632,7 @@ static VbError_t vboot_draw_base_screen_without_language(struct params *p)
 
 static VbError_t vboot_draw_blank(struct params *p)
 {
+	drawn_menu.strings = NULL;
 	video_console_clear();
 	return VBERROR_SUCCESS;
 }
@@ -549,12 +642,27 @@ static VbError_t vboot_draw_menu(struct params *p, const struct menu *m)
 	int i = 0;
 	int yoffset;
 	uint32_t flags;
+	int partial;
+
+	/*
+	 * If the same menu is still on screen, only the entries whose
+	 * highlight changed need to be redrawn. Entries are opaque, so
+	 * drawing over the old ones is enough.
+	 */
+	partial = !p->redraw_base && drawn_menu.strings == m->strings &&
+		  drawn_menu.locale == p->locale &&
+		  drawn_menu.disabled_idx_mask == p->disabled_idx_mask;
 
 	/* find starting point y offset */
 	yoffset = 0 - m->count/2;
 	for (i = 0; i < m->count; i++) {
 		if ((p->disabled_idx_mask & (1 << i)) != 0)
 			continue;
+		if (partial && i != p->selected_index &&
+		    i != drawn_menu.selected_index) {
+			yoffset++;
+			continue;
+		}
 		flags = PIVOT_H_CENTER|PIVOT_V_TOP;
 		if (p->selected_index == i)
 			flags |= INVERT_COLORS;
@@ -565,6 +673,11 @@ static VbError_t vboot_draw_menu(struct params *p, const struct menu *m)
 		yoffset++;
 	}
 
+	drawn_menu.strings = m->strings;
+	drawn_menu.locale = p->locale;
+	drawn_menu.selected_index = p->selected_index;
+	drawn_menu.disabled_idx_mask = p->disabled_idx_mask;
+
 	return VBERROR_SUCCESS;
 }
 
@@ -983,6 +1096,7 @@ static void print_fallback_message(const struct vboot_ui_descriptor *desc)
 {
 	const struct rgb_color white = { 0xff, 0xff, 0xff };
 
+	drawn_menu.strings = NULL;
 	if (desc->mesg)
 		graphics_print_single_text_block(desc->mesg, &white, 0, 15,
 						 VIDEO_PRINTF_ALIGN_CENTER);
@@ -1023,16 +1137,18 @@ static VbError_t draw_ui(uint32_t screen_type, struct params *p)
 
 static void vboot_init_locale(void)
 {
-	char *locales, *loc_start, *loc;
+	const char *locales;
+	char *loc_start, *loc;
 	size_t size;
 
 	locale_data.count = 0;
 
 	/* Load locale list from cbfs */
-	locales = cbfs_get_file_content(ro_cbfs, "locales",
-					CBFS_TYPE_RAW, &size);
+	locales = cbfs_index_map_file(ro_cbfs, "locales", CBFS_TYPE_RAW,
+				      &size);
 	if (!locales || !size) {
 		printf("%s: locale list not found\n", __func__);
+		cbfs_index_unmap_file(locales);
 		return;
 	}
 
@@ -1040,7 +1156,7 @@ static void vboot_init_locale(void)
 	loc_start = malloc(size + 1);
 	if (!loc_start) {
 		printf("%s: out of memory\n", __func__);
-		free(locales);
+		cbfs_index_unmap_file(locales);
 		return;
 	}
 	memcpy(loc_start, locales, size);
@@ -1058,7 +1174,7 @@ static void vboot_init_locale(void)
 		locale_data.codes[locale_data.count] = lang;
 		locale_data.count++;
 	}
-	free(locales);
+	cbfs_index_unmap_file(locales);
 
 	printf(" (%d locales)\n", locale_data.count);
 }
@@ -1085,6 +1201,7 @@ static VbError_t vboot_init_screen(void)
 
 	/* load font graphics */
 	load_archive("font.bin", &font_graphics);
+	init_font_glyphs();
 
 	/* reset localized graphics. we defer loading it. */
 	locale_data.archive = NULL;